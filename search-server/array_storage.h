@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Read-only array that either owns its elements or refers to memory owned
+// elsewhere, such as a mapped index file. The first mutable access copies
+// referenced elements into owned storage.
+template <typename T>
+class ArrayStorage {
+public:
+    ArrayStorage() = default;
+    explicit ArrayStorage(std::vector<T> values)
+        : owned_(std::move(values)) {
+    }
+
+    // The memory must outlive the storage and all of its copies
+    static ArrayStorage Refer(const T* data, size_t size) {
+        ArrayStorage storage;
+        storage.referred_ = data;
+        storage.referred_size_ = size;
+        return storage;
+    }
+
+    bool IsReferred() const {
+        return referred_ != nullptr;
+    }
+
+    const T* data() const {
+        return referred_ != nullptr ? referred_ : owned_.data();
+    }
+    size_t size() const {
+        return referred_ != nullptr ? referred_size_ : owned_.size();
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    const T* begin() const {
+        return data();
+    }
+    const T* end() const {
+        return data() + size();
+    }
+    const T& operator[](size_t index) const {
+        return data()[index];
+    }
+    const T& back() const {
+        return data()[size() - 1];
+    }
+    // Heap bytes held; referred memory is not counted
+    size_t GetMemoryUsage() const {
+        return owned_.capacity() * sizeof(T);
+    }
+
+    std::vector<T>& Mutable() {
+        if (referred_ != nullptr) {
+            owned_.assign(referred_, referred_ + referred_size_);
+            referred_ = nullptr;
+            referred_size_ = 0;
+        }
+        return owned_;
+    }
+
+private:
+    std::vector<T> owned_;
+    const T* referred_ = nullptr;
+    size_t referred_size_ = 0;
+};
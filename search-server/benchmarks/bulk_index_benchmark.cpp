@@ -0,0 +1,100 @@
+// Compares building an index with AddDocument one document at a time against
+// AddDocuments(execution::par, ...) with different numbers of worker threads.
+//
+// Usage: bulk_index_benchmark [document_count]
+//
+// The parallel STL algorithms run on TBB here, so the thread count is capped
+// with tbb::global_control.
+
+#include "../search_server.h"
+
+#include <tbb/global_control.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        const int length = uniform_int_distribution(1, max_length)(generator);
+        string word(length, ' ');
+        for (char& c : word) {
+            c = uniform_int_distribution<int>('a', 'z')(generator);
+        }
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+string GenerateText(mt19937& generator, const vector<string>& dictionary, int word_count) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            text.push_back(' ');
+        }
+        text += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return text;
+}
+
+template <typename Build>
+double MeasureSeconds(const string& stop_words, Build build) {
+    SearchServer search_server(stop_words);
+    const auto start = chrono::steady_clock::now();
+    build(search_server);
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    // Keeps the build from being optimized away
+    if (search_server.GetDocumentCount() < 0) {
+        cerr << search_server.GetDocumentCount();
+    }
+    return elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int document_count = argc > 1 ? atoi(argv[1]) : 500'000;
+
+    mt19937 generator(42);
+    const auto dictionary = GenerateDictionary(generator, 20'000, 10);
+    vector<NewDocument> documents;
+    documents.reserve(document_count);
+    for (int i = 0; i < document_count; ++i) {
+        documents.push_back({i, GenerateText(generator, dictionary, 70), DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+
+    const double one_by_one = MeasureSeconds(dictionary[0], [&documents](SearchServer& search_server) {
+        for (const NewDocument& document : documents) {
+            search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    });
+    cout << "mode=add_document seconds=" << one_by_one << endl;
+
+    const double sequential = MeasureSeconds(dictionary[0], [&documents](SearchServer& search_server) {
+        search_server.AddDocuments(documents);
+    });
+    cout << "mode=add_documents threads=seq seconds=" << sequential
+         << " speedup=" << one_by_one / sequential << endl;
+
+    const int max_threads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    for (int threads = 1; threads <= max_threads; threads = threads < max_threads ? min(threads * 2, max_threads) : threads + 1) {
+        tbb::global_control limit(tbb::global_control::max_allowed_parallelism, threads);
+        const double parallel = MeasureSeconds(dictionary[0], [&documents](SearchServer& search_server) {
+            search_server.AddDocuments(execution::par, documents);
+        });
+        cout << "mode=add_documents threads=" << threads << " seconds=" << parallel
+             << " speedup=" << one_by_one / parallel << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,114 @@
+// Measures search latency on a ConcurrentSearchServer while a writer thread
+// keeps adding and removing documents, compared with an idle index.
+//
+// Usage: concurrent_ingest_benchmark [document_count] [reader_count]
+
+#include "../concurrent_search_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        const int length = uniform_int_distribution(1, max_length)(generator);
+        string word(length, ' ');
+        for (char& c : word) {
+            c = uniform_int_distribution<int>('a', 'z')(generator);
+        }
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+string GenerateText(mt19937& generator, const vector<string>& dictionary, int word_count) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            text.push_back(' ');
+        }
+        text += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return text;
+}
+
+// Runs readers for a second and prints latency percentiles in microseconds
+void MeasureLatency(const string& mode, const ConcurrentSearchServer& search_server,
+                    const vector<string>& queries, int reader_count) {
+    atomic<bool> stop = false;
+    vector<vector<double>> latencies(reader_count);
+    vector<thread> readers;
+    for (int reader = 0; reader < reader_count; ++reader) {
+        readers.emplace_back([&, reader] {
+            for (size_t i = reader; !stop; i = (i + reader_count) % queries.size()) {
+                const auto start = chrono::steady_clock::now();
+                search_server.FindTopDocuments(queries[i]);
+                const chrono::duration<double, micro> elapsed = chrono::steady_clock::now() - start;
+                latencies[reader].push_back(elapsed.count());
+            }
+        });
+    }
+    this_thread::sleep_for(1s);
+    stop = true;
+    for (thread& reader : readers) {
+        reader.join();
+    }
+
+    vector<double> all;
+    for (const auto& reader_latencies : latencies) {
+        all.insert(all.end(), reader_latencies.begin(), reader_latencies.end());
+    }
+    sort(all.begin(), all.end());
+    const auto percentile = [&all](double p) {
+        return all.empty() ? 0.0 : all[static_cast<size_t>(p * (all.size() - 1))];
+    };
+    cout << "mode=" << mode << " queries=" << all.size() << " p50_us=" << percentile(0.5)
+         << " p99_us=" << percentile(0.99) << " max_us=" << percentile(1.0) << endl;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int document_count = argc > 1 ? atoi(argv[1]) : 100'000;
+    const int reader_count = argc > 2 ? atoi(argv[2]) : max(1, static_cast<int>(thread::hardware_concurrency()) - 1);
+
+    mt19937 generator(42);
+    const auto dictionary = GenerateDictionary(generator, 2'000, 10);
+    vector<NewDocument> documents;
+    for (int i = 0; i < document_count; ++i) {
+        documents.push_back({i, GenerateText(generator, dictionary, 30), DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+    SearchServer initial(dictionary[0]);
+    initial.AddDocuments(documents);
+    ConcurrentSearchServer search_server(move(initial));
+    vector<string> queries;
+    for (int i = 0; i < 1'000; ++i) {
+        queries.push_back(GenerateText(generator, dictionary, 5));
+    }
+
+    MeasureLatency("idle", search_server, queries, reader_count);
+
+    atomic<bool> stop = false;
+    thread writer([&] {
+        for (int id = document_count; !stop; ++id) {
+            search_server.AddDocument(id, GenerateText(generator, dictionary, 30), DocumentStatus::ACTUAL, {1});
+            search_server.RemoveDocument(id - document_count);
+        }
+    });
+    MeasureLatency("ingesting", search_server, queries, reader_count);
+    stop = true;
+    writer.join();
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Measures how FindTopDocuments(execution::par, ...) scales with the number of
+// worker threads on multi-term queries.
+//
+// Usage: parallel_search_benchmark [document_count] [query_count]
+//
+// The parallel STL algorithms run on TBB here, so the thread count is capped
+// with tbb::global_control.
+
+#include "../search_server.h"
+
+#include <tbb/global_control.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        const int length = uniform_int_distribution(1, max_length)(generator);
+        string word(length, ' ');
+        for (char& c : word) {
+            c = uniform_int_distribution<int>('a', 'z')(generator);
+        }
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+string GenerateText(mt19937& generator, const vector<string>& dictionary, int word_count) {
+    string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            text.push_back(' ');
+        }
+        text += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return text;
+}
+
+template <typename Policy>
+double MeasureSeconds(const Policy& policy, const SearchServer& search_server, const vector<string>& queries) {
+    const auto start = chrono::steady_clock::now();
+    size_t total_results = 0;
+    for (const string& query : queries) {
+        total_results += search_server.FindTopDocuments(policy, query).size();
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    // Keeps the loop from being optimized away
+    if (total_results == static_cast<size_t>(-1)) {
+        cerr << total_results;
+    }
+    return elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const int document_count = argc > 1 ? atoi(argv[1]) : 1'000'000;
+    const int query_count = argc > 2 ? atoi(argv[2]) : 200;
+
+    mt19937 generator(42);
+    const auto dictionary = GenerateDictionary(generator, 2'000, 10);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateText(generator, dictionary, 70), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    vector<string> queries;
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateText(generator, dictionary, 10));
+    }
+
+    const double sequential = MeasureSeconds(execution::seq, search_server, queries);
+    cout << "threads=seq seconds=" << sequential << endl;
+
+    const int max_threads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+    for (int threads = 1; threads <= max_threads; threads = threads < max_threads ? min(threads * 2, max_threads) : threads + 1) {
+        tbb::global_control limit(tbb::global_control::max_allowed_parallelism, threads);
+        const double parallel = MeasureSeconds(execution::par, search_server, queries);
+        cout << "threads=" << threads << " seconds=" << parallel
+             << " speedup=" << sequential / parallel << endl;
+    }
+    return 0;
+}
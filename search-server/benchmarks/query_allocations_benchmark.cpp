@@ -0,0 +1,132 @@
+// Counts heap allocations per query once the per-thread query arenas have
+// warmed up. The returned vector of results is the only allocation expected
+// on the uncached search and match paths; any other one makes the benchmark
+// exit with 1, so it doubles as the test of the steady-state query path.
+//
+// Usage: query_allocations_benchmark [document_count] [query_count]
+
+#include "../search_server.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+atomic<size_t> allocation_count = 0;
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        const int length = uniform_int_distribution(1, max_length)(generator);
+        string word(length, ' ');
+        for (char& c : word) {
+            c = uniform_int_distribution<int>('a', 'z')(generator);
+        }
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+string GenerateQuery(mt19937& generator, const vector<string>& dictionary, int word_count, double minus_prob) {
+    string query;
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            query.push_back(' ');
+        }
+        if (uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            query.push_back('-');
+        }
+        query += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+    }
+    return query;
+}
+
+struct Allocations {
+    size_t total = 0;
+    // Made by anything but the returned results
+    size_t scratch = 0;
+};
+
+// run(query) returns whether its result holds heap memory
+template <typename Run>
+Allocations MeasureAllocations(const vector<string>& queries, Run run) {
+    // The first pass grows the arenas and the score accumulator
+    for (const string& query : queries) {
+        run(query);
+    }
+    const size_t before = allocation_count.load();
+    size_t result_allocations = 0;
+    for (const string& query : queries) {
+        result_allocations += run(query) ? 1 : 0;
+    }
+    const size_t total = allocation_count.load() - before;
+    return {total, total - min(total, result_allocations)};
+}
+
+void PrintAllocations(const string& mode, const Allocations& allocations, size_t query_count) {
+    cout << mode << " allocations_per_query=" << static_cast<double>(allocations.total) / query_count
+         << " scratch_allocations=" << allocations.scratch << endl;
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+    ++allocation_count;
+    if (void* memory = malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+int main(int argc, char* argv[]) {
+    const int document_count = argc > 1 ? atoi(argv[1]) : 20'000;
+    const int query_count = argc > 2 ? atoi(argv[2]) : 2'000;
+
+    mt19937 generator(42);
+    const auto dictionary = GenerateDictionary(generator, 5'000, 10);
+    SearchServer search_server(dictionary[0]);
+    for (int i = 0; i < document_count; ++i) {
+        search_server.AddDocument(i, GenerateQuery(generator, dictionary, 50, 0), DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    vector<string> queries;
+    for (int i = 0; i < query_count; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, 7, 0.1));
+    }
+
+    bool has_scratch_allocations = false;
+    for (const QueryEvaluation evaluation : {QueryEvaluation::EXHAUSTIVE, QueryEvaluation::WAND}) {
+        search_server.SetQueryEvaluation(evaluation);
+        const Allocations allocations = MeasureAllocations(queries, [&search_server](const string& query) {
+            return search_server.FindTopDocuments(query).capacity() > 0;
+        });
+        PrintAllocations("mode=find_top_documents evaluation="s + (evaluation == QueryEvaluation::WAND ? "wand" : "exhaustive"),
+                         allocations, queries.size());
+        has_scratch_allocations = has_scratch_allocations || allocations.scratch > 0;
+    }
+
+    int document_id = 0;
+    const Allocations match_allocations = MeasureAllocations(queries, [&](const string& query) {
+        document_id = (document_id + 1) % document_count;
+        return get<0>(search_server.MatchDocument(query, document_id)).capacity() > 0;
+    });
+    PrintAllocations("mode=match_document", match_allocations, queries.size());
+    has_scratch_allocations = has_scratch_allocations || match_allocations.scratch > 0;
+    return has_scratch_allocations ? 1 : 0;
+}
@@ -0,0 +1,205 @@
+// Load generator for query_service: keeps a number of connections busy with
+// FIND requests for a while and reports throughput and latency percentiles as
+// one key=value line.
+//
+// Usage: query_service_load (port=<tcp port> | socket=<unix socket path>) queries=<file>
+//                           [connections=8] [pipeline=1] [seconds=10]
+//
+// Every connection runs on its own thread with pipeline requests in flight:
+// a request is sent as soon as a response arrives, cycling through the
+// queries in the file, one per line. Latency is measured from sending a
+// request to receiving its response.
+
+#include "../latency_histogram.h"
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+struct ConnectionResult {
+    LatencyHistogram latencies;
+    uint64_t request_count = 0;
+    uint64_t error_count = 0;
+};
+
+int Connect(const map<string, string>& options) {
+    if (options.count("socket")) {
+        const string& path = options.at("socket");
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            throw runtime_error("Unix socket path is too long");
+        }
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+            throw runtime_error("Cannot connect to "s + path);
+        }
+        return fd;
+    }
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(static_cast<uint16_t>(stoul(options.at("port"))));
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0) {
+        throw runtime_error("Cannot connect to 127.0.0.1:"s + options.at("port"));
+    }
+    const int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    return fd;
+}
+
+void SendAll(int fd, const string& data) {
+    for (size_t offset = 0; offset < data.size();) {
+        const ssize_t written = send(fd, data.data() + offset, data.size() - offset, MSG_NOSIGNAL);
+        if (written <= 0) {
+            throw runtime_error("Connection lost");
+        }
+        offset += static_cast<size_t>(written);
+    }
+}
+
+void RunConnection(int fd, const vector<string>& queries, size_t first_query, int pipeline, Clock::time_point deadline,
+                   ConnectionResult& result) {
+    deque<Clock::time_point> send_times;
+    size_t next_query = first_query;
+    const auto send_request = [&] {
+        send_times.push_back(Clock::now());
+        SendAll(fd, "FIND " + queries[next_query] + "\n");
+        next_query = (next_query + 1) % queries.size();
+    };
+    for (int i = 0; i < pipeline; ++i) {
+        send_request();
+    }
+
+    string input;
+    char buffer[64 * 1024];
+    while (!send_times.empty()) {
+        const ssize_t read_size = recv(fd, buffer, sizeof(buffer), 0);
+        if (read_size <= 0) {
+            throw runtime_error("Connection lost");
+        }
+        input.append(buffer, static_cast<size_t>(read_size));
+        size_t line_start = 0;
+        for (size_t line_end; (line_end = input.find('\n', line_start)) != string::npos; line_start = line_end + 1) {
+            const auto latency = chrono::duration_cast<chrono::microseconds>(Clock::now() - send_times.front());
+            send_times.pop_front();
+            result.latencies.Add(LatencyHistogram::GetBucketIndex(static_cast<uint64_t>(latency.count())));
+            ++result.request_count;
+            if (input.compare(line_start, 6, "ERROR ") == 0) {
+                ++result.error_count;
+            }
+            if (Clock::now() < deadline) {
+                send_request();
+            }
+        }
+        input.erase(0, line_start);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    map<string, string> options = {{"connections", "8"}, {"pipeline", "1"}, {"seconds", "10"}};
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (equals != string::npos) {
+            options[argument.substr(0, equals)] = argument.substr(equals + 1);
+        }
+    }
+    if (options.count("queries") == 0 || (options.count("port") == 0 && options.count("socket") == 0)) {
+        cerr << "Usage: query_service_load (port=<tcp port> | socket=<unix socket path>) queries=<file>"
+                " [connections=8] [pipeline=1] [seconds=10]" << endl;
+        return 1;
+    }
+
+    vector<string> queries;
+    ifstream query_file(options.at("queries"));
+    for (string line; getline(query_file, line);) {
+        if (!line.empty()) {
+            queries.push_back(move(line));
+        }
+    }
+    if (queries.empty()) {
+        cerr << "No queries in " << options.at("queries") << endl;
+        return 1;
+    }
+
+    const int connection_count = stoi(options.at("connections"));
+    const int pipeline = max(1, stoi(options.at("pipeline")));
+    vector<int> fds;
+    try {
+        for (int i = 0; i < connection_count; ++i) {
+            fds.push_back(Connect(options));
+        }
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+
+    vector<ConnectionResult> results(connection_count);
+    vector<thread> threads;
+    atomic<bool> failed = false;
+    const auto start = Clock::now();
+    const auto deadline = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(stod(options.at("seconds"))));
+    for (int i = 0; i < connection_count; ++i) {
+        threads.emplace_back([&, i] {
+            try {
+                RunConnection(fds[i], queries, i * queries.size() / connection_count, pipeline, deadline, results[i]);
+            } catch (const exception& error) {
+                cerr << error.what() << endl;
+                failed = true;
+            }
+        });
+    }
+    for (thread& thread : threads) {
+        thread.join();
+    }
+    const double seconds = chrono::duration<double>(Clock::now() - start).count();
+    for (const int fd : fds) {
+        close(fd);
+    }
+
+    ConnectionResult total;
+    for (const ConnectionResult& result : results) {
+        total.latencies.Merge(result.latencies);
+        total.request_count += result.request_count;
+        total.error_count += result.error_count;
+    }
+    cout << "connections=" << connection_count
+         << " pipeline=" << pipeline
+         << " requests=" << total.request_count
+         << " errors=" << total.error_count
+         << " seconds=" << seconds
+         << " qps=" << total.request_count / seconds
+         << " p50_us=" << total.latencies.GetValueAtPercentile(50)
+         << " p90_us=" << total.latencies.GetValueAtPercentile(90)
+         << " p99_us=" << total.latencies.GetValueAtPercentile(99)
+         << " p999_us=" << total.latencies.GetValueAtPercentile(99.9)
+         << " max_us=" << total.latencies.GetValueAtPercentile(100) << endl;
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,432 @@
+// Runs the main SearchServer operations over a generated corpus and prints one
+// key=value line per operation, so results of two builds can be diffed.
+//
+// Usage: search_benchmark [key=value...]
+//
+//   seed            corpus generator seed                         (42)
+//   documents       number of documents                           (100000)
+//   queries         number of queries                             (1000)
+//   vocabulary      number of distinct non-stop words             (50000)
+//   zipf            exponent of the word rank distribution        (1.0)
+//   document_words  words per document                            (50)
+//   query_words     words per query                               (5)
+//   stop_words      share of document words that are stop words   (0.2)
+//   minus_words     share of query words that are minus words     (0.1)
+//   duplicates      share of documents repeating an earlier one   (0.05)
+//   batch           queries per ProcessQueries call               (100)
+//
+// The corpus depends only on the parameters: words are drawn by rank from a
+// Zipf distribution, and all randomness comes from mt19937_64 bits rather than
+// the implementation-defined standard distributions.
+//
+// Every line reports the number of operations, the total time, throughput in
+// operations per second, p50 and p99 latency of a single call in microseconds
+// (LatencyHistogram bucket bounds, so within 1/16 of the true value) and the
+// peak resident set size of the process so far in kilobytes.
+//
+// Built by the CMake project in the parent directory:
+//   cmake -S . -B build && cmake --build build --target search_benchmark
+
+#include "../latency_histogram.h"
+#include "../process_queries.h"
+#include "../remove_duplicates.h"
+#include "../search_server.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <execution>
+#include <iostream>
+#include <map>
+#include <random>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr int STOP_WORD_COUNT = 30;
+
+struct Options {
+    map<string, double> values = {
+        {"seed", 42},
+        {"documents", 100'000},
+        {"queries", 1'000},
+        {"vocabulary", 50'000},
+        {"zipf", 1.0},
+        {"document_words", 50},
+        {"query_words", 5},
+        {"stop_words", 0.2},
+        {"minus_words", 0.1},
+        {"duplicates", 0.05},
+        {"batch", 100},
+    };
+
+    int GetInt(const string& key) const {
+        return static_cast<int>(values.at(key));
+    }
+    double GetDouble(const string& key) const {
+        return values.at(key);
+    }
+};
+
+Options ParseOptions(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const size_t equals = argument.find('=');
+        const auto it = equals == string::npos ? options.values.end() : options.values.find(argument.substr(0, equals));
+        if (it == options.values.end()) {
+            cerr << "Unknown argument " << argument << ", expected key=value with key one of:";
+            for (const auto& [key, value] : options.values) {
+                cerr << " " << key;
+            }
+            cerr << endl;
+            exit(1);
+        }
+        it->second = atof(argument.c_str() + equals + 1);
+    }
+    return options;
+}
+
+// Uniform in [0, 1) from the top 53 bits
+double NextUnit(mt19937_64& generator) {
+    return static_cast<double>(generator() >> 11) * 0x1.0p-53;
+}
+
+size_t NextIndex(mt19937_64& generator, size_t size) {
+    return generator() % size;
+}
+
+// Rank r in [0, size) is drawn with probability proportional to 1 / (r + 1)^exponent
+class ZipfDistribution {
+public:
+    ZipfDistribution(size_t size, double exponent) {
+        cumulative_.reserve(size);
+        double sum = 0.0;
+        for (size_t rank = 0; rank < size; ++rank) {
+            sum += 1.0 / pow(static_cast<double>(rank + 1), exponent);
+            cumulative_.push_back(sum);
+        }
+        for (double& value : cumulative_) {
+            value /= sum;
+        }
+    }
+
+    size_t operator()(mt19937_64& generator) const {
+        const auto it = upper_bound(cumulative_.begin(), cumulative_.end(), NextUnit(generator));
+        return min(static_cast<size_t>(it - cumulative_.begin()), cumulative_.size() - 1);
+    }
+
+private:
+    vector<double> cumulative_;
+};
+
+struct Corpus {
+    vector<string> stop_words;
+    vector<NewDocument> documents;
+    vector<string> queries;
+};
+
+// Distinct words of 3 to 12 letters
+vector<string> GenerateWords(mt19937_64& generator, size_t count) {
+    vector<string> words;
+    words.reserve(count);
+    unordered_set<string> seen;
+    while (words.size() < count) {
+        string word(3 + NextIndex(generator, 10), ' ');
+        for (char& c : word) {
+            c = static_cast<char>('a' + NextIndex(generator, 26));
+        }
+        if (seen.insert(word).second) {
+            words.push_back(move(word));
+        }
+    }
+    return words;
+}
+
+Corpus GenerateCorpus(const Options& options) {
+    mt19937_64 generator(options.GetInt("seed"));
+    vector<string> words = GenerateWords(generator, STOP_WORD_COUNT + options.GetInt("vocabulary"));
+    Corpus corpus;
+    corpus.stop_words.assign(words.begin(), words.begin() + STOP_WORD_COUNT);
+    words.erase(words.begin(), words.begin() + STOP_WORD_COUNT);
+    const ZipfDistribution zipf(words.size(), options.GetDouble("zipf"));
+
+    const int document_count = options.GetInt("documents");
+    const int document_words = options.GetInt("document_words");
+    corpus.documents.reserve(document_count);
+    for (int id = 0; id < document_count; ++id) {
+        NewDocument document;
+        document.id = id;
+        document.ratings = {static_cast<int>(NextIndex(generator, 11)) - 5, static_cast<int>(NextIndex(generator, 11)) - 5};
+        vector<string_view> text;
+        if (id > 0 && NextUnit(generator) < options.GetDouble("duplicates")) {
+            // The same words as an earlier document, in a different order
+            const string& original = corpus.documents[NextIndex(generator, id)].text;
+            text = SplitIntoWords(original);
+            for (size_t i = text.size(); i > 1; --i) {
+                swap(text[i - 1], text[NextIndex(generator, i)]);
+            }
+        } else {
+            for (int i = 0; i < document_words; ++i) {
+                text.push_back(NextUnit(generator) < options.GetDouble("stop_words")
+                                   ? corpus.stop_words[NextIndex(generator, STOP_WORD_COUNT)]
+                                   : words[zipf(generator)]);
+            }
+        }
+        for (string_view word : text) {
+            if (!document.text.empty()) {
+                document.text.push_back(' ');
+            }
+            document.text += word;
+        }
+        corpus.documents.push_back(move(document));
+    }
+
+    const int query_count = options.GetInt("queries");
+    const int query_words = options.GetInt("query_words");
+    corpus.queries.reserve(query_count);
+    for (int i = 0; i < query_count; ++i) {
+        string query;
+        for (int j = 0; j < query_words; ++j) {
+            if (j > 0) {
+                query.push_back(' ');
+            }
+            if (NextUnit(generator) < options.GetDouble("minus_words")) {
+                query.push_back('-');
+            }
+            query += words[zipf(generator)];
+        }
+        corpus.queries.push_back(move(query));
+    }
+    return corpus;
+}
+
+long GetPeakRssKilobytes() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+class OperationStats {
+public:
+    template <typename Func>
+    void Measure(size_t operations, Func func) {
+        const auto start = chrono::steady_clock::now();
+        func();
+        const auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start);
+        operations_ += operations;
+        elapsed_ += elapsed;
+        latencies_.Add(LatencyHistogram::GetBucketIndex(static_cast<uint64_t>(elapsed.count())));
+    }
+
+    void Print(const string& name, const string& policy) const {
+        const double seconds = chrono::duration<double>(elapsed_).count();
+        cout << "benchmark=" << name << " policy=" << policy
+             << " operations=" << operations_
+             << " seconds=" << seconds
+             << " throughput=" << (seconds > 0 ? operations_ / seconds : 0.0)
+             << " p50_us=" << latencies_.GetValueAtPercentile(50) / 1000.0
+             << " p99_us=" << latencies_.GetValueAtPercentile(99) / 1000.0
+             << " peak_rss_kb=" << GetPeakRssKilobytes() << endl;
+    }
+
+private:
+    size_t operations_ = 0;
+    chrono::nanoseconds elapsed_{0};
+    LatencyHistogram latencies_;
+};
+
+// Keeps results alive so that the measured calls are not optimized away
+size_t total_results = 0;
+
+template <typename Policy>
+void BenchmarkFindTopDocuments(const Policy& policy, const string& policy_name, const SearchServer& search_server,
+                               const vector<string>& queries) {
+    OperationStats stats;
+    for (const string& query : queries) {
+        stats.Measure(1, [&] {
+            total_results += search_server.FindTopDocuments(policy, query).size();
+        });
+    }
+    stats.Print("find_top_documents", policy_name);
+}
+
+template <typename Policy>
+void BenchmarkMatchDocument(const Policy& policy, const string& policy_name, const SearchServer& search_server,
+                            const vector<string>& queries, int document_count) {
+    OperationStats stats;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const int document_id = static_cast<int>(i * 7919 % document_count);
+        stats.Measure(1, [&] {
+            total_results += get<0>(search_server.MatchDocument(policy, queries[i], document_id)).size();
+        });
+    }
+    stats.Print("match_document", policy_name);
+}
+
+// RemoveDuplicates reports every removed document on cout
+class SilencedOutput {
+public:
+    SilencedOutput()
+        : saved_(cout.rdbuf(&null_buffer_)) {
+    }
+    ~SilencedOutput() {
+        cout.rdbuf(saved_);
+    }
+
+private:
+    struct NullBuffer : streambuf {
+        int overflow(int c) override {
+            return c;
+        }
+    };
+    NullBuffer null_buffer_;
+    streambuf* saved_;
+};
+
+template <typename Policy>
+void BenchmarkRemoveDuplicates(const Policy& policy, const string& policy_name, const Corpus& corpus) {
+    SearchServer search_server(corpus.stop_words);
+    search_server.AddDocuments(execution::par, corpus.documents);
+    OperationStats stats;
+    stats.Measure(corpus.documents.size(), [&] {
+        SilencedOutput silenced;
+        RemoveDuplicates(policy, search_server);
+    });
+    total_results += search_server.GetDocumentCount();
+    stats.Print("remove_duplicates", policy_name);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const Options options = ParseOptions(argc, argv);
+    cout << "suite=search_benchmark";
+    for (const auto& [key, value] : options.values) {
+        cout << " " << key << "=" << value;
+    }
+    cout << endl;
+
+    const Corpus corpus = GenerateCorpus(options);
+    const int document_count = static_cast<int>(corpus.documents.size());
+    {
+        SearchServer search_server(corpus.stop_words);
+        OperationStats add_stats;
+        for (const NewDocument& document : corpus.documents) {
+            add_stats.Measure(1, [&] {
+                search_server.AddDocument(document.id, document.text, document.status, document.ratings);
+            });
+        }
+        add_stats.Print("add_document", "seq");
+
+        if (!corpus.queries.empty() && document_count > 0) {
+            // Warms up the per-thread scratch memory of both paths
+            const vector<string> warm_up(corpus.queries.begin(), corpus.queries.begin() + min<size_t>(corpus.queries.size(), 100));
+            for (const string& query : warm_up) {
+                total_results += search_server.FindTopDocuments(execution::seq, query).size();
+                total_results += search_server.FindTopDocuments(execution::par, query).size();
+            }
+
+            BenchmarkFindTopDocuments(execution::seq, "seq", search_server, corpus.queries);
+            BenchmarkFindTopDocuments(execution::par, "par", search_server, corpus.queries);
+            BenchmarkMatchDocument(execution::seq, "seq", search_server, corpus.queries, document_count);
+            BenchmarkMatchDocument(execution::par, "par", search_server, corpus.queries, document_count);
+
+            const size_t batch_size = max(1, options.GetInt("batch"));
+            OperationStats process_stats;
+            for (size_t first = 0; first < corpus.queries.size(); first += batch_size) {
+                const vector<string> batch(corpus.queries.begin() + first,
+                                           corpus.queries.begin() + min(first + batch_size, corpus.queries.size()));
+                process_stats.Measure(batch.size(), [&] {
+                    total_results += ProcessQueries(search_server, batch).size();
+                });
+            }
+            process_stats.Print("process_queries", "par");
+
+            // The same queries scored from precomputed impacts
+            for (const auto& [mode, mode_name] : {pair{ImpactScoring::FLOAT, "float"s},
+                                                  pair{ImpactScoring::QUANTIZED, "quantized"s}}) {
+                SearchServer impact_server = search_server;
+                OperationStats build_stats;
+                build_stats.Measure(1, [&] {
+                    impact_server.SetImpactScoring(mode);
+                });
+                build_stats.Print("build_impacts", mode_name);
+                BenchmarkFindTopDocuments(execution::seq, "impact_" + mode_name + "_seq", impact_server, corpus.queries);
+                BenchmarkFindTopDocuments(execution::par, "impact_" + mode_name + "_par", impact_server, corpus.queries);
+            }
+        }
+
+        // Removes half of the documents, alternating the policies so that both
+        // see an index of about the same size
+        vector<int> ids(document_count);
+        for (int i = 0; i < document_count; ++i) {
+            ids[i] = i;
+        }
+        mt19937_64 generator(options.GetInt("seed"));
+        for (size_t i = ids.size(); i > 1; --i) {
+            swap(ids[i - 1], ids[NextIndex(generator, i)]);
+        }
+        SearchServer tombstone_server = search_server;
+        tombstone_server.SetDeletionMode(DeletionMode::TOMBSTONE);
+        SearchServer batch_server = search_server;
+
+        OperationStats remove_seq_stats;
+        OperationStats remove_par_stats;
+        int removed_count = 0;
+        for (int i = 0; i + 1 < document_count / 2; i += 2) {
+            remove_seq_stats.Measure(1, [&] {
+                search_server.RemoveDocument(execution::seq, ids[i]);
+            });
+            remove_par_stats.Measure(1, [&] {
+                search_server.RemoveDocument(execution::par, ids[i + 1]);
+            });
+            removed_count = i + 2;
+        }
+        remove_seq_stats.Print("remove_document", "seq");
+        remove_par_stats.Print("remove_document", "par");
+
+        // The same documents, marked removed and then compacted away at once
+        OperationStats tombstone_stats;
+        for (int i = 0; i < removed_count; ++i) {
+            tombstone_stats.Measure(1, [&] {
+                tombstone_server.RemoveDocument(ids[i]);
+            });
+        }
+        tombstone_stats.Print("remove_document", "tombstone");
+        OperationStats compact_stats;
+        compact_stats.Measure(1, [&] {
+            tombstone_server.CompactIndex(execution::par);
+        });
+        compact_stats.Print("compact_index", "par");
+
+        // The same documents again, in batches of the size of a query batch
+        OperationStats batch_stats;
+        const int batch_size = max(1, options.GetInt("batch"));
+        for (int first = 0; first < removed_count; first += batch_size) {
+            const vector<int> batch(ids.begin() + first, ids.begin() + min(first + batch_size, removed_count));
+            batch_stats.Measure(batch.size(), [&] {
+                batch_server.RemoveDocuments(execution::par, batch);
+            });
+        }
+        batch_stats.Print("remove_documents", "par");
+    }
+
+    BenchmarkRemoveDuplicates(execution::seq, "seq", corpus);
+    BenchmarkRemoveDuplicates(execution::par, "par", corpus);
+
+    if (total_results == static_cast<size_t>(-1)) {
+        cerr << total_results;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+// Measures tokenizer throughput in MB/s: the single-pass SplitIntoWords, which
+// splits on spaces and finds control characters together, against the previous
+// find/find_first_not_of split followed by a byte-by-byte validation of every word.
+//
+// Usage: tokenizer_benchmark [megabytes] [repeat_count]
+
+#include "../string_processing.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+vector<string> GenerateDictionary(mt19937& generator, int word_count, int max_length) {
+    vector<string> words;
+    words.reserve(word_count);
+    for (int i = 0; i < word_count; ++i) {
+        const int length = uniform_int_distribution(1, max_length)(generator);
+        string word(length, ' ');
+        for (char& c : word) {
+            c = uniform_int_distribution<int>('a', 'z')(generator);
+        }
+        words.push_back(move(word));
+    }
+    return words;
+}
+
+// Documents of about 70 words, like the other benchmarks index
+vector<string> GenerateTexts(mt19937& generator, const vector<string>& dictionary, size_t total_size) {
+    vector<string> texts;
+    size_t size = 0;
+    while (size < total_size) {
+        string text;
+        for (int i = 0; i < 70; ++i) {
+            if (i > 0) {
+                text.push_back(' ');
+            }
+            text += dictionary[uniform_int_distribution<int>(0, dictionary.size() - 1)(generator)];
+        }
+        size += text.size();
+        texts.push_back(move(text));
+    }
+    return texts;
+}
+
+// The tokenizer the index used before
+size_t SplitAndValidateTwoPass(string_view text, vector<string_view>& words) {
+    text.remove_prefix(min(text.find_first_not_of(' '), text.size()));
+    while (!text.empty()) {
+        const auto word = text.substr(0, text.find(' '));
+        words.push_back(word);
+        text.remove_prefix(word.size());
+        text.remove_prefix(min(text.find_first_not_of(' '), text.size()));
+    }
+    for (size_t i = 0; i < words.size(); ++i) {
+        if (any_of(words[i].begin(), words[i].end(), [](char c) { return c >= '\0' && c < ' '; })) {
+            return i;
+        }
+    }
+    return words.size();
+}
+
+template <typename Split>
+double MeasureMegabytesPerSecond(const vector<string>& texts, int repeat_count, Split split) {
+    size_t total_size = 0;
+    size_t word_count = 0;
+    vector<string_view> words;
+    const auto start = chrono::steady_clock::now();
+    for (int repeat = 0; repeat < repeat_count; ++repeat) {
+        for (const string& text : texts) {
+            words.clear();
+            word_count += split(text, words) + words.size();
+            total_size += text.size();
+        }
+    }
+    const chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+    // Keeps the loop from being optimized away
+    if (word_count == 0) {
+        cerr << word_count;
+    }
+    return total_size / 1e6 / elapsed.count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    const size_t megabytes = argc > 1 ? atoi(argv[1]) : 64;
+    const int repeat_count = argc > 2 ? atoi(argv[2]) : 5;
+
+    mt19937 generator(42);
+    const auto dictionary = GenerateDictionary(generator, 20'000, 10);
+    const auto texts = GenerateTexts(generator, dictionary, megabytes * 1'000'000);
+
+#if defined(__AVX2__)
+    const char* const simd = "avx2";
+#elif defined(__SSE2__)
+    const char* const simd = "sse2";
+#else
+    const char* const simd = "scalar";
+#endif
+
+    const double two_pass = MeasureMegabytesPerSecond(texts, repeat_count, SplitAndValidateTwoPass);
+    cout << "mode=two_pass mb_per_second=" << two_pass << endl;
+
+    const double single_pass = MeasureMegabytesPerSecond(texts, repeat_count, [](string_view text, vector<string_view>& words) {
+        return SplitIntoWords(text, words);
+    });
+    cout << "mode=single_pass simd=" << simd << " mb_per_second=" << single_pass
+         << " speedup=" << single_pass / two_pass << endl;
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include "bit_packing.h"
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+uint32_t GetRequiredBitWidth(const uint32_t* values) {
+    uint32_t all_bits = 0;
+    for (size_t i = 0; i < PACKED_BLOCK_SIZE; ++i) {
+        all_bits |= values[i];
+    }
+    uint32_t bit_width = 0;
+    while (bit_width < 32 && (all_bits >> bit_width) != 0) {
+        ++bit_width;
+    }
+    return bit_width;
+}
+
+void PackBlock(const uint32_t* values, uint32_t bit_width, uint32_t* out) {
+    fill(out, out + GetPackedWordCount(bit_width), 0u);
+    for (uint32_t j = 0; j < PACKED_BLOCK_SIZE / 4; ++j) {
+        const uint32_t word = j * bit_width / 32;
+        const uint32_t shift = j * bit_width % 32;
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            const uint32_t value = values[4 * j + lane];
+            out[4 * word + lane] |= value << shift;
+            if (shift + bit_width > 32) {
+                out[4 * (word + 1) + lane] |= value >> (32 - shift);
+            }
+        }
+    }
+}
+
+void UnpackBlock(const uint32_t* in, uint32_t bit_width, uint32_t* values) {
+    if (bit_width == 0) {
+        fill(values, values + PACKED_BLOCK_SIZE, 0u);
+        return;
+    }
+    const uint32_t mask = bit_width == 32 ? ~0u : (1u << bit_width) - 1;
+#ifdef __SSE2__
+    const __m128i mask_vector = _mm_set1_epi32(static_cast<int>(mask));
+    for (uint32_t j = 0; j < PACKED_BLOCK_SIZE / 4; ++j) {
+        const uint32_t word = j * bit_width / 32;
+        const uint32_t shift = j * bit_width % 32;
+        const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * word));
+        __m128i value = _mm_srl_epi32(low, _mm_cvtsi32_si128(static_cast<int>(shift)));
+        if (shift + bit_width > 32) {
+            const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * (word + 1)));
+            value = _mm_or_si128(value, _mm_sll_epi32(high, _mm_cvtsi32_si128(static_cast<int>(32 - shift))));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(values + 4 * j), _mm_and_si128(value, mask_vector));
+    }
+#else
+    for (uint32_t j = 0; j < PACKED_BLOCK_SIZE / 4; ++j) {
+        const uint32_t word = j * bit_width / 32;
+        const uint32_t shift = j * bit_width % 32;
+        for (uint32_t lane = 0; lane < 4; ++lane) {
+            uint32_t value = in[4 * word + lane] >> shift;
+            if (shift + bit_width > 32) {
+                value |= in[4 * (word + 1) + lane] << (32 - shift);
+            }
+            values[4 * j + lane] = value & mask;
+        }
+    }
+#endif
+}
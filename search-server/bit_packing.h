@@ -0,0 +1,21 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+// Bit packing of fixed blocks of 128 unsigned integers in the vertical layout
+// of SIMD-BP128: value i belongs to lane i % 4, and word k of lane l is stored at
+// index 4 * k + l. Decoding then shifts and masks four lanes with one SSE2
+// instruction each, with a scalar fallback on other targets.
+
+constexpr size_t PACKED_BLOCK_SIZE = 128;
+
+// Smallest bit width that holds every value of the block
+uint32_t GetRequiredBitWidth(const uint32_t* values);
+
+// Number of 32-bit words a block of the given bit width occupies
+constexpr size_t GetPackedWordCount(uint32_t bit_width) {
+    return 4 * bit_width;
+}
+
+void PackBlock(const uint32_t* values, uint32_t bit_width, uint32_t* out);
+void UnpackBlock(const uint32_t* in, uint32_t bit_width, uint32_t* values);
@@ -0,0 +1,216 @@
+#include "concurrent_search_server.h"
+#include <execution>
+#include <stdexcept>
+
+using namespace std;
+
+ConcurrentSearchServer::Snapshot::Snapshot(Version *version)
+    : version_(version)
+{
+}
+
+ConcurrentSearchServer::Snapshot::Snapshot(Snapshot &&other) noexcept
+    : version_(exchange(other.version_, nullptr))
+{
+}
+
+ConcurrentSearchServer::Snapshot &ConcurrentSearchServer::Snapshot::operator=(Snapshot &&other) noexcept
+{
+    if (this != &other)
+    {
+        if (version_ != nullptr)
+        {
+            version_->reader_count.fetch_sub(1, memory_order_release);
+        }
+        version_ = exchange(other.version_, nullptr);
+    }
+    return *this;
+}
+
+ConcurrentSearchServer::Snapshot::~Snapshot()
+{
+    if (version_ != nullptr)
+    {
+        // Pairs with the acquiring load in WaitForReaders, so the writer sees all reads finished
+        version_->reader_count.fetch_sub(1, memory_order_release);
+    }
+}
+
+const SearchServer &ConcurrentSearchServer::Snapshot::operator*() const
+{
+    return *version_->search_server;
+}
+
+const SearchServer *ConcurrentSearchServer::Snapshot::operator->() const
+{
+    return version_->search_server.get();
+}
+
+ConcurrentSearchServer::Version::Version(SearchServer search_server)
+    : search_server(make_unique<SearchServer>(move(search_server)))
+{
+}
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer search_server)
+    : versions_{Version(search_server), Version(move(search_server))}
+    , current_(&versions_[0])
+{
+}
+
+ConcurrentSearchServer::Snapshot ConcurrentSearchServer::GetSnapshot() const
+{
+    while (true)
+    {
+        Version *version = current_.load();
+        version->reader_count.fetch_add(1);
+        // A writer that retired the version before the count went up may
+        // already be changing it; it cannot have missed the count otherwise
+        if (current_.load() == version)
+        {
+            return Snapshot(version);
+        }
+        version->reader_count.fetch_sub(1, memory_order_release);
+    }
+}
+
+ConcurrentSearchServer::~ConcurrentSearchServer()
+{
+    StopBackgroundCompaction();
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const
+{
+    return GetSnapshot()->GetDocumentCount();
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, const string &document, DocumentStatus status,
+                                         const vector<int> &ratings)
+{
+    ApplyUpdate([&](SearchServer &search_server)
+                { search_server.AddDocument(document_id, document, status, ratings); },
+                true);
+}
+
+void ConcurrentSearchServer::AddDocuments(const vector<NewDocument> &documents)
+{
+    ApplyUpdate([&documents](SearchServer &search_server)
+                { search_server.AddDocuments(execution::par, documents); },
+                true);
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id)
+{
+    ApplyUpdate([document_id](SearchServer &search_server)
+                { search_server.RemoveDocument(document_id); },
+                true);
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const vector<int> &document_ids)
+{
+    ApplyUpdate([&document_ids](SearchServer &search_server)
+                { search_server.RemoveDocuments(execution::par, document_ids); },
+                true);
+}
+
+void ConcurrentSearchServer::CompactIndex()
+{
+    Update([](SearchServer &search_server)
+           { search_server.CompactIndex(execution::par); });
+}
+
+void ConcurrentSearchServer::StartBackgroundCompaction(size_t min_removed_words, chrono::milliseconds interval)
+{
+    StopBackgroundCompaction();
+    is_compaction_stopping_ = false;
+    compaction_thread_ = thread([this, min_removed_words, interval]
+                                {
+        unique_lock lock(compaction_mutex_);
+        while (!compaction_stopped_.wait_for(lock, interval, [this]
+                                             { return is_compaction_stopping_; }))
+        {
+            lock.unlock();
+            const size_t removed_word_count = GetSnapshot()->GetRemovedWordCount();
+            if (removed_word_count > 0 && removed_word_count >= min_removed_words)
+            {
+                CompactIndex();
+            }
+            lock.lock();
+        } });
+}
+
+void ConcurrentSearchServer::StopBackgroundCompaction()
+{
+    if (!compaction_thread_.joinable())
+    {
+        return;
+    }
+    {
+        lock_guard lock(compaction_mutex_);
+        is_compaction_stopping_ = true;
+    }
+    compaction_stopped_.notify_one();
+    compaction_thread_.join();
+}
+
+void ConcurrentSearchServer::Update(const function<void(SearchServer &)> &change)
+{
+    ApplyUpdate(change, false);
+}
+
+void ConcurrentSearchServer::ApplyUpdate(const function<void(SearchServer &)> &change, bool is_checked)
+{
+    lock_guard lock(write_mutex_);
+    Version *spare = GetSpare();
+    try
+    {
+        change(*spare->search_server);
+    }
+    catch (const logic_error &)
+    {
+        if (!is_checked)
+        {
+            ResetSpare();
+        }
+        throw;
+    }
+    catch (...)
+    {
+        // The change may have been applied partly
+        ResetSpare();
+        throw;
+    }
+    Version *retired = current_.exchange(spare);
+    WaitForReaders(*retired);
+    try
+    {
+        change(*retired->search_server);
+    }
+    catch (...)
+    {
+        // Only resources can run out here, as the change succeeded on an equal copy
+        ResetSpare();
+        throw;
+    }
+}
+
+ConcurrentSearchServer::Version *ConcurrentSearchServer::GetSpare()
+{
+    return &versions_[0] == current_.load() ? &versions_[1] : &versions_[0];
+}
+
+void ConcurrentSearchServer::ResetSpare()
+{
+    // Readers never pin the spare, so only its index is replaced; a reader
+    // late to see it retired may still touch its count
+    Version *spare = GetSpare();
+    spare->search_server = make_unique<SearchServer>(*current_.load()->search_server);
+}
+
+void ConcurrentSearchServer::WaitForReaders(const Version &version)
+{
+    // Readers that pinned the version before it was retired hold a count
+    while (version.reader_count.load() > 0)
+    {
+        this_thread::yield();
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "search_server.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// SearchServer for mixed workloads: searches run while documents are added
+// and removed, and never wait for writers.
+//
+// Readers pin an immutable version of the index with an atomic reader count.
+// A writer applies a change to a spare copy of the index and publishes it,
+// then waits until no reader pins the previous version and applies the same
+// change to it, so it becomes the next spare. Writers wait for each other and
+// for readers of the retired version; readers wait for nobody. The index is
+// kept twice in memory, but a change costs two applications, not a copy.
+// Versions live as long as the server, so a reader may touch the count of a
+// version retired under it; only the index inside a version is replaced.
+class ConcurrentSearchServer
+{
+    struct Version;
+
+public:
+    // Pins a version of the index, which stays unchanged while the snapshot
+    // is alive. Holding it for long delays the writer after next
+    class Snapshot
+    {
+    public:
+        Snapshot(Snapshot &&other) noexcept;
+        Snapshot &operator=(Snapshot &&other) noexcept;
+        ~Snapshot();
+
+        const SearchServer &operator*() const;
+        const SearchServer *operator->() const;
+
+    private:
+        friend class ConcurrentSearchServer;
+        explicit Snapshot(Version *version);
+
+        Version *version_;
+    };
+
+    explicit ConcurrentSearchServer(SearchServer search_server);
+    // Stops background compaction
+    ~ConcurrentSearchServer();
+
+    Snapshot GetSnapshot() const;
+
+    template <typename... Args>
+    std::vector<Document> FindTopDocuments(Args &&...args) const
+    {
+        return GetSnapshot()->FindTopDocuments(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    std::vector<Document> FindTopDocumentsPage(Args &&...args) const
+    {
+        return GetSnapshot()->FindTopDocumentsPage(std::forward<Args>(args)...);
+    }
+    // Pages taken from different snapshots may skip or repeat documents
+    // changed in between
+    template <typename... Args>
+    std::vector<Document> FindTopDocumentsAfter(Args &&...args) const
+    {
+        return GetSnapshot()->FindTopDocumentsAfter(std::forward<Args>(args)...);
+    }
+    // Matched words stay valid while the server is alive
+    template <typename... Args>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(Args &&...args) const
+    {
+        return GetSnapshot()->MatchDocument(std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(Args &&...args) const
+    {
+        return GetSnapshot()->MatchDocuments(std::forward<Args>(args)...);
+    }
+    int GetDocumentCount() const;
+
+    void AddDocument(int document_id, const std::string &document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+    void AddDocuments(const std::vector<NewDocument> &documents);
+    void RemoveDocument(int document_id);
+    void RemoveDocuments(const std::vector<int> &document_ids);
+    // Runs CompactIndex as a change of its own; searches go on meanwhile
+    void CompactIndex();
+    // Starts a thread that checks every interval whether the index holds at
+    // least min_removed_words words of removed documents, see
+    // SearchServer::GetRemovedWordCount, and compacts it if so. Replaces the
+    // thread of an earlier call
+    void StartBackgroundCompaction(size_t min_removed_words, std::chrono::milliseconds interval);
+    // Waits for a compaction in progress to finish
+    void StopBackgroundCompaction();
+    // Applies several changes as one version. The change is run twice, on two
+    // equal copies of the index, and must do the same on both. If it throws,
+    // nothing is published, the spare is copied anew from the current version
+    // and the exception is rethrown
+    void Update(const std::function<void(SearchServer &)> &change);
+
+private:
+    struct Version
+    {
+        explicit Version(SearchServer search_server);
+
+        // Replaced as a whole when the spare is copied anew
+        std::unique_ptr<SearchServer> search_server;
+        std::atomic<int> reader_count = 0;
+    };
+
+    Version versions_[2];
+    std::atomic<Version *> current_;
+    std::mutex write_mutex_;
+    std::thread compaction_thread_;
+    std::mutex compaction_mutex_;
+    std::condition_variable compaction_stopped_;
+    bool is_compaction_stopping_ = false;
+
+    // is_checked: the change throws std::logic_error only before it changes
+    // anything, as the methods of SearchServer check their arguments first.
+    // A spare it rejects is then left as it is instead of being copied anew
+    void ApplyUpdate(const std::function<void(SearchServer &)> &change, bool is_checked);
+    Version *GetSpare();
+    // Replaces the index of the spare with a copy of the current version
+    void ResetSpare();
+    static void WaitForReaders(const Version &version);
+};
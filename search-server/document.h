@@ -1,5 +1,7 @@
 #pragma once
 #include <iostream>
+#include <string>
+#include <vector>
 
 enum class DocumentStatus {
     ACTUAL,
@@ -16,4 +18,12 @@ struct Document {
     int rating = 0;
 };
 
+// A document for SearchServer::AddDocuments
+struct NewDocument {
+    int id = 0;
+    std::string text;
+    DocumentStatus status = DocumentStatus::ACTUAL;
+    std::vector<int> ratings;
+};
+
 std::ostream& operator<<(std::ostream& out, const Document& document);
\ No newline at end of file
@@ -0,0 +1,41 @@
+#include "document_fingerprint.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+// Finalizer of SplitMix64: every input bit affects every output bit
+uint64_t Mix(uint64_t value) {
+    value ^= value >> 30;
+    value *= 0xbf58476d1ce4e5b9ULL;
+    value ^= value >> 27;
+    value *= 0x94d049bb133111ebULL;
+    value ^= value >> 31;
+    return value;
+}
+
+}  // namespace
+
+void DocumentFingerprint::AddWord(string_view word) {
+    // The two lanes are seeded and combined differently, so they collide independently
+    uint64_t word_low = 0x9e3779b97f4a7c15ULL ^ word.size();
+    uint64_t word_high = 0xc2b2ae3d27d4eb4fULL + word.size();
+    for (size_t position = 0; position < word.size(); position += sizeof(uint64_t)) {
+        uint64_t chunk = 0;
+        memcpy(&chunk, word.data() + position, min(sizeof(uint64_t), word.size() - position));
+        word_low = Mix(word_low ^ chunk);
+        word_high = Mix(word_high + chunk * 0x9fb21c651e98df25ULL);
+    }
+    low += word_low;
+    high += Mix(word_high ^ word_low);
+}
+
+bool operator==(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs) {
+    return lhs.low == rhs.low && lhs.high == rhs.high;
+}
+
+bool operator!=(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs) {
+    return !(lhs == rhs);
+}
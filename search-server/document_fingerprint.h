@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// 128-bit fingerprint of a set of words: the lane-wise sum of two independent
+// 64-bit hashes of every word. The sum does not depend on the order of the
+// words, so a set is fingerprinted in one pass without sorting it, and equal
+// sets of words give equal fingerprints whatever term ids the index gave them.
+struct DocumentFingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    // Words of the set must be added once each
+    void AddWord(std::string_view word);
+};
+
+bool operator==(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs);
+bool operator!=(const DocumentFingerprint& lhs, const DocumentFingerprint& rhs);
+
+struct DocumentFingerprintHash {
+    size_t operator()(const DocumentFingerprint& fingerprint) const {
+        return static_cast<size_t>(fingerprint.low ^ fingerprint.high);
+    }
+};
@@ -0,0 +1,38 @@
+#include "impact_list.h"
+#include <cmath>
+#include <utility>
+
+using namespace std;
+
+namespace {
+// Quantized value of the largest impact of a list
+constexpr double MAX_QUANTIZED_IMPACT = 0xFFFF;
+}  // namespace
+
+ImpactList::ImpactList(vector<int> ordinals, const vector<double>& term_freqs, double inverse_document_freq,
+                       bool quantized)
+    : ordinals_(move(ordinals))
+    , inverse_document_freq_(inverse_document_freq) {
+    if (!quantized || term_freqs.empty()) {
+        impacts_.reserve(term_freqs.size());
+        for (const double term_freq : term_freqs) {
+            impacts_.push_back(static_cast<float>(term_freq * inverse_document_freq));
+        }
+        return;
+    }
+    const double max_impact = *max_element(term_freqs.begin(), term_freqs.end()) * inverse_document_freq;
+    quantum_ = max_impact > 0.0 ? max_impact / MAX_QUANTIZED_IMPACT : 0.0;
+    quantized_impacts_.reserve(term_freqs.size());
+    for (const double term_freq : term_freqs) {
+        const double impact = term_freq * inverse_document_freq;
+        quantized_impacts_.push_back(quantum_ > 0.0 ? static_cast<uint16_t>(lround(impact / quantum_)) : 0);
+    }
+}
+
+ImpactList ImpactList::Renumbered(const vector<int>& new_ordinals) const {
+    ImpactList impacts(*this);
+    for (int& ordinal : impacts.ordinals_) {
+        ordinal = new_ordinals[ordinal];
+    }
+    return impacts;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Precomputed relevance contributions of a single word: the term frequency in
+// every document containing it times the word's inverse document frequency at
+// the time the list was built. Ordinals and impacts are stored plain and
+// contiguous, so scoring the word is a run of additions.
+//
+// A quantized list keeps impacts in 16 bits relative to the largest one, half
+// the size of float impacts; an impact is then off by up to 1e-5 of the largest.
+class ImpactList {
+public:
+    // Ordinals are sorted; term_freqs are the word's frequencies in them
+    ImpactList(std::vector<int> ordinals, const std::vector<double>& term_freqs, double inverse_document_freq,
+               bool quantized);
+
+    // The same impacts with every ordinal replaced by new_ordinals[ordinal];
+    // the mapping must keep the order of the ordinals
+    ImpactList Renumbered(const std::vector<int>& new_ordinals) const;
+
+    double GetInverseDocumentFreq() const {
+        return inverse_document_freq_;
+    }
+    bool IsQuantized() const {
+        return !quantized_impacts_.empty();
+    }
+    size_t size() const {
+        return ordinals_.size();
+    }
+
+    // Calls func(ordinal, impact) for every document with ordinal in [first, last)
+    template <typename Func>
+    void ForEachImpact(int first, int last, Func func) const;
+    template <typename Func>
+    void ForEachImpact(Func func) const {
+        ForEachImpact(INT_MIN, INT_MAX, func);
+    }
+
+private:
+    std::vector<int> ordinals_;
+    // One of the two is filled
+    std::vector<float> impacts_;
+    std::vector<uint16_t> quantized_impacts_;
+    // Impact of a quantized value of one
+    double quantum_ = 0.0;
+    double inverse_document_freq_;
+};
+
+template <typename Func>
+void ImpactList::ForEachImpact(int first, int last, Func func) const {
+    const size_t begin = std::lower_bound(ordinals_.begin(), ordinals_.end(), first) - ordinals_.begin();
+    const size_t end = std::lower_bound(ordinals_.begin() + begin, ordinals_.end(), last) - ordinals_.begin();
+    if (IsQuantized()) {
+        for (size_t i = begin; i < end; ++i) {
+            func(ordinals_[i], quantized_impacts_[i] * quantum_);
+        }
+        return;
+    }
+    for (size_t i = begin; i < end; ++i) {
+        func(ordinals_[i], static_cast<double>(impacts_[i]));
+    }
+}
@@ -0,0 +1,106 @@
+#include "index_snapshot.h"
+#include <cstring>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order_mark;
+};
+
+constexpr size_t SECTION_ALIGNMENT = 8;
+
+size_t AlignSection(size_t size) {
+    return (size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+}  // namespace
+
+SnapshotWriter::SnapshotWriter(ostream& out)
+    : out_(out) {
+    SnapshotHeader header{};
+    memcpy(header.magic, INDEX_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = INDEX_SNAPSHOT_VERSION;
+    header.byte_order_mark = INDEX_SNAPSHOT_BYTE_ORDER_MARK;
+    out_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+}
+
+void SnapshotWriter::WriteStrings(const vector<string_view>& strings) {
+    vector<uint64_t> offsets{0};
+    for (const string_view str : strings) {
+        offsets.push_back(offsets.back() + str.size());
+    }
+    WriteArray(offsets);
+    const uint64_t size = offsets.back();
+    out_.write(reinterpret_cast<const char*>(&size), sizeof(size));
+    for (const string_view str : strings) {
+        out_.write(str.data(), str.size());
+    }
+    static const char padding[SECTION_ALIGNMENT] = {};
+    out_.write(padding, AlignSection(size) - size);
+}
+
+void SnapshotWriter::WriteSection(const char* data, size_t size) {
+    const uint64_t section_size = size;
+    out_.write(reinterpret_cast<const char*>(&section_size), sizeof(section_size));
+    out_.write(data, size);
+    static const char padding[SECTION_ALIGNMENT] = {};
+    out_.write(padding, AlignSection(size) - size);
+}
+
+SnapshotReader::SnapshotReader(const MappedFile& file)
+    : data_(file.data())
+    , size_(file.size())
+    , offset_(sizeof(SnapshotHeader)) {
+    SnapshotHeader header;
+    if (size_ < sizeof(header)) {
+        ThrowCorrupted();
+    }
+    memcpy(&header, data_, sizeof(header));
+    if (memcmp(header.magic, INDEX_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0
+        || header.byte_order_mark != INDEX_SNAPSHOT_BYTE_ORDER_MARK) {
+        throw runtime_error("Not an index snapshot"s);
+    }
+    if (header.version != INDEX_SNAPSHOT_VERSION) {
+        throw runtime_error("Unsupported index snapshot version "s + to_string(header.version));
+    }
+}
+
+vector<string_view> SnapshotReader::ReadStrings() {
+    const ArrayStorage<uint64_t> offsets = ReadArray<uint64_t>();
+    const auto [chars, size] = ReadSection();
+    if (offsets.empty() || offsets.back() != size) {
+        ThrowCorrupted();
+    }
+    vector<string_view> strings;
+    strings.reserve(offsets.size() - 1);
+    for (size_t i = 0; i + 1 < offsets.size(); ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            ThrowCorrupted();
+        }
+        strings.emplace_back(chars + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+    return strings;
+}
+
+pair<const char*, size_t> SnapshotReader::ReadSection() {
+    uint64_t size;
+    if (size_ - offset_ < sizeof(size)) {
+        ThrowCorrupted();
+    }
+    memcpy(&size, data_ + offset_, sizeof(size));
+    offset_ += sizeof(size);
+    // The first check keeps AlignSection from overflowing on a damaged size
+    if (size > size_ - offset_ || size_ - offset_ < AlignSection(size)) {
+        ThrowCorrupted();
+    }
+    const char* section = data_ + offset_;
+    offset_ += AlignSection(size);
+    return {section, size};
+}
+
+void SnapshotReader::ThrowCorrupted() {
+    throw runtime_error("Index snapshot is corrupted"s);
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include "array_storage.h"
+#include "mapped_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Binary index snapshot: a header followed by sections. Each section is its
+// 64-bit byte size and its bytes padded to a multiple of 8, so arrays keep their
+// alignment and can be read in place from a mapping of the file. Values are
+// stored in the byte order of the machine that wrote the file; the header
+// records it and the reader rejects foreign files.
+
+constexpr char INDEX_SNAPSHOT_MAGIC[8] = {'S', 'R', 'C', 'H', 'I', 'D', 'X', '\0'};
+constexpr uint32_t INDEX_SNAPSHOT_VERSION = 2;
+constexpr uint32_t INDEX_SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(std::ostream& out);
+
+    template <typename T>
+    void WriteArray(const T* data, size_t size) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        WriteSection(reinterpret_cast<const char*>(data), size * sizeof(T));
+    }
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        WriteArray(values.data(), values.size());
+    }
+    template <typename T>
+    void WriteArray(const ArrayStorage<T>& values) {
+        WriteArray(values.data(), values.size());
+    }
+    template <typename T>
+    void WriteValue(const T& value) {
+        WriteArray(&value, 1);
+    }
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+private:
+    std::ostream& out_;
+
+    void WriteSection(const char* data, size_t size);
+};
+
+// Reads sections in the order they were written. Throws std::runtime_error
+// if the file is not a snapshot of this version or is truncated
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const MappedFile& file);
+
+    // The result refers to the mapping
+    template <typename T>
+    ArrayStorage<T> ReadArray() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        const auto [data, size] = ReadSection();
+        if (size % sizeof(T) != 0) {
+            ThrowCorrupted();
+        }
+        return ArrayStorage<T>::Refer(reinterpret_cast<const T*>(data), size / sizeof(T));
+    }
+    template <typename T>
+    T ReadValue() {
+        const ArrayStorage<T> values = ReadArray<T>();
+        if (values.size() != 1) {
+            ThrowCorrupted();
+        }
+        return values[0];
+    }
+    // The views point into the mapping
+    std::vector<std::string_view> ReadStrings();
+
+    [[noreturn]] static void ThrowCorrupted();
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t offset_;
+
+    std::pair<const char*, size_t> ReadSection();
+};
@@ -0,0 +1,143 @@
+#include "instrumentation.h"
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+
+#include "latency_histogram.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+constexpr size_t STAGE_COUNT = static_cast<size_t>(QueryStage::COUNT);
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(QueryCounter::COUNT);
+
+const char* const STAGE_NAMES[STAGE_COUNT] = {"parse", "resolve", "postings", "minus_words", "top_k", "sort"};
+const char* const COUNTER_NAMES[COUNTER_COUNT] = {"postings_scanned", "postings_filtered_out", "postings_excluded",
+                                                  "documents_ranked"};
+
+// Sums of finished threads and of the dumped ones
+struct Totals {
+    array<LatencyHistogram, STAGE_COUNT> stages;
+    array<uint64_t, STAGE_COUNT> stage_nanoseconds{};
+    array<uint64_t, COUNTER_COUNT> counters{};
+};
+
+// Written by its thread only, read by dumps: relaxed atomics keep the reads
+// race-free while the owner's updates compile to plain loads and stores
+class ThreadRecorder {
+public:
+    ThreadRecorder();
+    ~ThreadRecorder();
+
+    void Increment(atomic<uint64_t>& value, uint64_t delta) {
+        value.store(value.load(memory_order_relaxed) + delta, memory_order_relaxed);
+    }
+
+    void RecordStage(size_t stage, uint64_t nanoseconds) {
+        Increment(stage_counts_[stage][LatencyHistogram::GetBucketIndex(nanoseconds)], 1);
+        Increment(stage_nanoseconds_[stage], nanoseconds);
+    }
+    void RecordCount(size_t counter, uint64_t value) {
+        Increment(counters_[counter], value);
+    }
+
+    void AddTo(Totals& totals) const;
+
+private:
+    array<array<atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT>, STAGE_COUNT> stage_counts_{};
+    array<atomic<uint64_t>, STAGE_COUNT> stage_nanoseconds_{};
+    array<atomic<uint64_t>, COUNTER_COUNT> counters_{};
+};
+
+struct Registry {
+    std::mutex mutex;
+    vector<const ThreadRecorder*> recorders;
+    Totals finished;
+};
+
+// Never destroyed, so threads finishing after main can still unregister
+Registry& GetRegistry() {
+    static Registry* registry = new Registry;
+    return *registry;
+}
+
+ThreadRecorder::ThreadRecorder() {
+    Registry& registry = GetRegistry();
+    lock_guard lock(registry.mutex);
+    registry.recorders.push_back(this);
+}
+
+ThreadRecorder::~ThreadRecorder() {
+    Registry& registry = GetRegistry();
+    lock_guard lock(registry.mutex);
+    AddTo(registry.finished);
+    registry.recorders.erase(find(registry.recorders.begin(), registry.recorders.end(), this));
+}
+
+void ThreadRecorder::AddTo(Totals& totals) const {
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            if (const uint64_t count = stage_counts_[stage][i].load(memory_order_relaxed)) {
+                totals.stages[stage].Add(i, count);
+            }
+        }
+        totals.stage_nanoseconds[stage] += stage_nanoseconds_[stage].load(memory_order_relaxed);
+    }
+    for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+        totals.counters[counter] += counters_[counter].load(memory_order_relaxed);
+    }
+}
+
+ThreadRecorder& GetThreadRecorder() {
+    static thread_local ThreadRecorder recorder;
+    return recorder;
+}
+
+}  // namespace
+
+void RecordStage(QueryStage stage, chrono::steady_clock::duration duration) {
+    const auto nanoseconds = chrono::duration_cast<chrono::nanoseconds>(duration).count();
+    GetThreadRecorder().RecordStage(static_cast<size_t>(stage), static_cast<uint64_t>(max<decltype(nanoseconds)>(0, nanoseconds)));
+}
+
+void RecordCount(QueryCounter counter, uint64_t value) {
+    GetThreadRecorder().RecordCount(static_cast<size_t>(counter), value);
+}
+
+void DumpInstrumentation(ostream& out) {
+    Registry& registry = GetRegistry();
+    Totals totals;
+    {
+        lock_guard lock(registry.mutex);
+        totals = registry.finished;
+        for (const ThreadRecorder* recorder : registry.recorders) {
+            recorder->AddTo(totals);
+        }
+    }
+    for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+        const LatencyHistogram& histogram = totals.stages[stage];
+        out << "stage=" << STAGE_NAMES[stage]
+            << " count=" << histogram.GetTotalCount()
+            << " total_ns=" << totals.stage_nanoseconds[stage]
+            << " p50_ns=" << histogram.GetValueAtPercentile(50.0)
+            << " p90_ns=" << histogram.GetValueAtPercentile(90.0)
+            << " p99_ns=" << histogram.GetValueAtPercentile(99.0)
+            << " max_ns=" << histogram.GetValueAtPercentile(100.0) << '\n';
+    }
+    for (size_t counter = 0; counter < COUNTER_COUNT; ++counter) {
+        out << "counter=" << COUNTER_NAMES[counter] << " value=" << totals.counters[counter] << '\n';
+    }
+}
+
+#else
+
+void DumpInstrumentation(std::ostream& out) {
+    out << "instrumentation=off\n";
+}
+
+#endif
@@ -0,0 +1,81 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Timers and counters on the query path, compiled in only when
+// SEARCH_SERVER_INSTRUMENTATION is defined; otherwise INSTRUMENT_STAGE and
+// INSTRUMENT_COUNT expand to nothing. Every translation unit must be built
+// with the same setting.
+//
+// Each thread records into its own counters, which only it writes, so
+// recording is a few plain loads and stores. Stage durations are kept in
+// nanosecond histograms. DumpInstrumentation sums all threads, the finished
+// ones included.
+
+// Stages of a search, timed by INSTRUMENT_STAGE
+enum class QueryStage {
+    // Splitting the query into plus and minus words
+    PARSE,
+    // Looking the words up in the index and computing their IDF
+    RESOLVE,
+    // Scoring postings of plus words; documents are filtered on the way, and
+    // WAND and parallel searches do all their work in this stage
+    POSTINGS,
+    // Excluding documents of minus words
+    MINUS_WORDS,
+    // Selecting the best scored documents
+    TOP_K,
+    // Sorting the selected documents
+    SORT,
+    COUNT,
+};
+
+// Events counted by INSTRUMENT_COUNT
+enum class QueryCounter {
+    POSTINGS_SCANNED,
+    // Postings of documents rejected by the status or predicate
+    POSTINGS_FILTERED_OUT,
+    POSTINGS_EXCLUDED,
+    DOCUMENTS_RANKED,
+    COUNT,
+};
+
+// Writes a key=value line per stage and counter; says so if instrumentation is compiled out
+void DumpInstrumentation(std::ostream& out);
+
+#ifdef SEARCH_SERVER_INSTRUMENTATION
+
+void RecordStage(QueryStage stage, std::chrono::steady_clock::duration duration);
+void RecordCount(QueryCounter counter, uint64_t value);
+
+// Records the time from construction to destruction
+class StageTimer {
+public:
+    explicit StageTimer(QueryStage stage)
+        : stage_(stage) {
+    }
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+    ~StageTimer() {
+        RecordStage(stage_, std::chrono::steady_clock::now() - start_);
+    }
+
+private:
+    const QueryStage stage_;
+    const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+#define INSTRUMENT_CONCAT_INTERNAL(X, Y) X##Y
+#define INSTRUMENT_CONCAT(X, Y) INSTRUMENT_CONCAT_INTERNAL(X, Y)
+// Times the rest of the enclosing block as the stage
+#define INSTRUMENT_STAGE(stage) StageTimer INSTRUMENT_CONCAT(stage_timer_, __LINE__)(stage)
+#define INSTRUMENT_COUNT(counter, value) RecordCount(counter, value)
+
+#else
+
+#define INSTRUMENT_STAGE(stage) ((void)0)
+#define INSTRUMENT_COUNT(counter, value) ((void)0)
+
+#endif
@@ -0,0 +1,81 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+// Number of significant bits; value must not be 0
+size_t GetBitWidth(uint64_t value) {
+#if defined(__GNUC__)
+    return 64 - __builtin_clzll(value);
+#else
+    size_t width = 0;
+    for (; value != 0; value >>= 1) {
+        ++width;
+    }
+    return width;
+#endif
+}
+
+}  // namespace
+
+size_t LatencyHistogram::GetBucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    // The top SUB_BUCKET_BITS + 1 significant bits pick the bucket
+    const size_t range = GetBitWidth(value) - SUB_BUCKET_BITS - 1;
+    if (range >= RANGE_COUNT) {
+        return BUCKET_COUNT - 1;
+    }
+    const size_t sub_bucket = static_cast<size_t>(value >> range) - SUB_BUCKET_COUNT;
+    return SUB_BUCKET_COUNT * (range + 1) + sub_bucket;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    const size_t range = index / SUB_BUCKET_COUNT - 1;
+    const uint64_t lower_bound = static_cast<uint64_t>(SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << range;
+    return lower_bound + (uint64_t{1} << range) - 1;
+}
+
+void LatencyHistogram::Add(size_t index, uint64_t count) {
+    if (counts_.empty()) {
+        counts_.resize(BUCKET_COUNT);
+    }
+    counts_[index] += count;
+    total_count_ += count;
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < other.counts_.size(); ++i) {
+        if (other.counts_[i] != 0) {
+            Add(i, other.counts_[i]);
+        }
+    }
+}
+
+void LatencyHistogram::Clear() {
+    fill(counts_.begin(), counts_.end(), 0);
+    total_count_ = 0;
+}
+
+uint64_t LatencyHistogram::GetValueAtPercentile(double percentile) const {
+    if (total_count_ == 0) {
+        return 0;
+    }
+    const double rank = clamp(percentile, 0.0, 100.0) / 100.0 * total_count_;
+    const uint64_t target = max<uint64_t>(1, static_cast<uint64_t>(ceil(rank)));
+    uint64_t count = 0;
+    for (size_t i = 0; i < counts_.size(); ++i) {
+        count += counts_[i];
+        if (count >= target) {
+            return GetBucketUpperBound(i);
+        }
+    }
+    return GetBucketUpperBound(counts_.size() - 1);
+}
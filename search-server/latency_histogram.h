@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Log-linear histogram in the spirit of HdrHistogram: values below
+// SUB_BUCKET_COUNT have a bucket each, and every power-of-two range above is
+// split into SUB_BUCKET_COUNT equal buckets, so a value is known to within
+// 1/SUB_BUCKET_COUNT of itself. Values beyond the last bucket are counted in it.
+class LatencyHistogram {
+public:
+    static constexpr size_t SUB_BUCKET_BITS = 4;
+    static constexpr size_t SUB_BUCKET_COUNT = size_t{1} << SUB_BUCKET_BITS;
+    // Powers of two above SUB_BUCKET_COUNT that get buckets: values up to 2^40
+    static constexpr size_t RANGE_COUNT = 40 - SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT * (RANGE_COUNT + 1);
+
+    static size_t GetBucketIndex(uint64_t value);
+    // The largest value counted in the bucket
+    static uint64_t GetBucketUpperBound(size_t index);
+
+    void Add(size_t index, uint64_t count = 1);
+    void Merge(const LatencyHistogram& other);
+    void Clear();
+
+    uint64_t GetTotalCount() const {
+        return total_count_;
+    }
+    // Upper bound of the bucket holding the value below which percentile
+    // percent of the values lie; 0 for an empty histogram
+    uint64_t GetValueAtPercentile(double percentile) const;
+
+private:
+    // Allocated on the first Add, so unused histograms stay small
+    std::vector<uint64_t> counts_;
+    uint64_t total_count_ = 0;
+};
@@ -1,5 +1,10 @@
 #pragma once
+#include "document.h"
+#include "search_cursor.h"
+#include <cstddef>
 #include <iostream>
+#include <iterator>
+#include <utility>
 #include <vector>
 
 template <typename Iterator>
@@ -58,4 +63,88 @@ private:
 template <typename Container>
 auto Paginate(const Container& c, size_t page_size) {
     return Paginator(begin(c), end(c), page_size);
-}
\ No newline at end of file
+}
+
+// Pages of search results fetched one at a time while they are iterated.
+// fetch(after, page_size) returns at most page_size results ranked below the
+// cursor, as SearchServer::FindTopDocumentsAfter does; the first page follows
+// SearchCursor::First(). Only the current page is kept, and reaching a page
+// costs one bounded search per page before it instead of ranking everything
+template <typename FetchPage>
+class LazyPaginator {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type = std::vector<Document>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        reference operator*() const {
+            return page_;
+        }
+        pointer operator->() const {
+            return &page_;
+        }
+        Iterator& operator++() {
+            // A short page is the last one, so no search is needed to find the end
+            if (page_.size() < paginator_->page_size_) {
+                paginator_ = nullptr;
+            } else {
+                Fetch(SearchCursor::After(page_.back()));
+            }
+            ++page_index_;
+            return *this;
+        }
+        bool operator==(const Iterator& other) const {
+            return paginator_ == other.paginator_ && (paginator_ == nullptr || page_index_ == other.page_index_);
+        }
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class LazyPaginator;
+
+        // The end iterator when paginator is nullptr
+        explicit Iterator(const LazyPaginator* paginator)
+            : paginator_(paginator) {
+            if (paginator_ != nullptr) {
+                Fetch(SearchCursor::First());
+            }
+        }
+
+        void Fetch(const SearchCursor& after) {
+            page_ = paginator_->page_size_ == 0 ? value_type() : paginator_->fetch_(after, paginator_->page_size_);
+            if (page_.empty()) {
+                paginator_ = nullptr;
+            }
+        }
+
+        const LazyPaginator* paginator_;
+        value_type page_;
+        size_t page_index_ = 0;
+    };
+
+    LazyPaginator(FetchPage fetch, size_t page_size)
+        : fetch_(std::move(fetch))
+        , page_size_(page_size) {
+    }
+    // Runs the search for the first page
+    Iterator begin() const {
+        return Iterator(this);
+    }
+    Iterator end() const {
+        return Iterator(nullptr);
+    }
+
+private:
+    FetchPage fetch_;
+    size_t page_size_;
+};
+
+template <typename FetchPage>
+auto PaginateLazily(FetchPage fetch, size_t page_size) {
+    return LazyPaginator<FetchPage>(std::move(fetch), page_size);
+}
@@ -0,0 +1,471 @@
+#include "posting_list.h"
+#include "bit_packing.h"
+#include "index_snapshot.h"
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+using namespace std;
+
+static_assert(PostingList::BLOCK_SIZE == PACKED_BLOCK_SIZE);
+
+namespace {
+// Largest quantized term frequency, which decodes to the block maximum
+constexpr uint32_t MAX_QUANTIZED_TERM_FREQ = 0xFFFF;
+// Words holding the quantized term frequencies of a block, two per word
+constexpr size_t TERM_FREQ_WORD_COUNT = PostingList::BLOCK_SIZE / 2;
+
+// Words of a packed block before its ordinal deltas: the header, then the first ordinal
+constexpr size_t BLOCK_HEADER_WORD_COUNT = 2;
+
+// The first word of a packed block: the bit width of the deltas in the low
+// byte and the number of postings above it
+uint32_t MakeBlockHeader(uint32_t bit_width, size_t size) {
+    return bit_width | static_cast<uint32_t>(size) << 8;
+}
+
+uint32_t GetBlockBitWidth(uint32_t header) {
+    return header & 0xFF;
+}
+
+size_t GetBlockSize(uint32_t header) {
+    return header >> 8;
+}
+
+// Layout of a packed block: the header, the first ordinal, 4 * bit width words
+// of ordinal deltas minus one, then BLOCK_SIZE / 2 words of 16-bit term
+// frequencies. A block holds 1 to BLOCK_SIZE postings; the rest is padded with
+// zeros. Blocks do not refer to each other, so one can be replaced alone
+void EncodeBlock(const int* ordinals, const double* term_freqs, size_t size, double block_max,
+                 vector<uint32_t>& out) {
+    uint32_t deltas[PostingList::BLOCK_SIZE] = {};
+    for (size_t i = 1; i < size; ++i) {
+        deltas[i] = static_cast<uint32_t>(ordinals[i] - ordinals[i - 1] - 1);
+    }
+    const uint32_t bit_width = GetRequiredBitWidth(deltas);
+
+    out.push_back(MakeBlockHeader(bit_width, size));
+    out.push_back(static_cast<uint32_t>(ordinals[0]));
+    const size_t deltas_offset = out.size();
+    out.resize(deltas_offset + GetPackedWordCount(bit_width) + TERM_FREQ_WORD_COUNT);
+    PackBlock(deltas, bit_width, out.data() + deltas_offset);
+
+    uint32_t* term_freq_words = out.data() + deltas_offset + GetPackedWordCount(bit_width);
+    for (size_t i = 0; i < size; ++i) {
+        const uint32_t quantized = block_max > 0.0
+                                       ? static_cast<uint32_t>(lround(term_freqs[i] / block_max * MAX_QUANTIZED_TERM_FREQ))
+                                       : 0;
+        term_freq_words[i / 2] |= min(quantized, MAX_QUANTIZED_TERM_FREQ) << (i % 2 * 16);
+    }
+}
+
+// Scalar fields of a list in a snapshot, followed by its arrays
+struct PostingListHeader {
+    uint64_t compressed;
+    uint64_t packed_block_count;
+    double max_term_freq;
+};
+}  // namespace
+
+PostingList::Cursor::Cursor(const PostingList& postings)
+    : postings_(&postings) {
+    if (!IsAtEnd()) {
+        LoadBlock(0);
+    }
+}
+
+void PostingList::Cursor::Next() {
+    if (++index_ == block_size_ && ++block_ < postings_->GetBlockCount()) {
+        LoadBlock(block_);
+    }
+}
+
+void PostingList::Cursor::Seek(int target) {
+    if (GetOrdinal() >= target) {
+        return;
+    }
+    const size_t block_count = postings_->GetBlockCount();
+    size_t block = block_;
+    while (block < block_count && postings_->block_last_ordinals_[block] < target) {
+        ++block;
+    }
+    if (block == block_count) {
+        block_ = block_count;
+        return;
+    }
+    if (block != block_) {
+        LoadBlock(block);
+    }
+    const Block view = GetBlock();
+    index_ = lower_bound(view.ordinals + index_, view.ordinals + view.size, target) - view.ordinals;
+}
+
+PostingList::Block PostingList::Cursor::GetBlock() const {
+    if (plain_ordinals_ != nullptr) {
+        return {plain_ordinals_, plain_term_freqs_, block_size_};
+    }
+    return {buffer_.ordinals, buffer_.term_freqs, block_size_};
+}
+
+void PostingList::Cursor::LoadBlock(size_t block) {
+    const Block view = postings_->GetBlock(block, buffer_);
+    const bool is_plain = view.ordinals != buffer_.ordinals;
+    plain_ordinals_ = is_plain ? view.ordinals : nullptr;
+    plain_term_freqs_ = is_plain ? view.term_freqs : nullptr;
+    block_size_ = view.size;
+    block_ = block;
+    index_ = 0;
+}
+
+PostingList::PostingList(bool compressed)
+    : compressed_(compressed) {
+}
+
+void PostingList::Add(int ordinal, double term_freq) {
+    // Ordinals are handed out in ascending order and all words of a document
+    // are added together, so the target is almost always the last element
+    if (!ordinals_.empty() && ordinals_.back() == ordinal) {
+        double& last_term_freq = term_freqs_.Mutable().back();
+        last_term_freq += term_freq;
+        double& block_max_term_freq = block_max_term_freqs_.Mutable().back();
+        block_max_term_freq = max(block_max_term_freq, last_term_freq);
+        max_term_freq_ = max(max_term_freq_, last_term_freq);
+        return;
+    }
+    if (ordinal > GetLastOrdinal()) {
+        // The last block is full; a compressed list packs it first
+        if (ordinals_.size() % BLOCK_SIZE == 0) {
+            if (compressed_ && !ordinals_.empty()) {
+                PackTailBlock();
+            }
+            block_last_ordinals_.Mutable().push_back(ordinal);
+            block_max_term_freqs_.Mutable().push_back(term_freq);
+        } else {
+            block_last_ordinals_.Mutable().back() = ordinal;
+            double& block_max_term_freq = block_max_term_freqs_.Mutable().back();
+            block_max_term_freq = max(block_max_term_freq, term_freq);
+        }
+        ordinals_.Mutable().push_back(ordinal);
+        term_freqs_.Mutable().push_back(term_freq);
+        max_term_freq_ = max(max_term_freq_, term_freq);
+        return;
+    }
+    const auto insert = [ordinal, term_freq](vector<int>& ordinals, vector<double>& term_freqs) {
+        const auto it = lower_bound(ordinals.begin(), ordinals.end(), ordinal);
+        const auto pos = distance(ordinals.begin(), it);
+        if (it != ordinals.end() && *it == ordinal) {
+            term_freqs[pos] += term_freq;
+        } else {
+            ordinals.insert(it, ordinal);
+            term_freqs.insert(term_freqs.begin() + pos, term_freq);
+        }
+        return pos;
+    };
+    if (compressed_) {
+        EditBlock(FindBlock(ordinal), insert);
+        return;
+    }
+    RebuildBlocksFrom(insert(ordinals_.Mutable(), term_freqs_.Mutable()));
+}
+
+bool PostingList::Remove(int ordinal) {
+    if (!Contains(ordinal)) {
+        return false;
+    }
+    const auto erase = [ordinal](vector<int>& ordinals, vector<double>& term_freqs) {
+        const auto it = lower_bound(ordinals.begin(), ordinals.end(), ordinal);
+        const auto pos = distance(ordinals.begin(), it);
+        term_freqs.erase(term_freqs.begin() + pos);
+        ordinals.erase(it);
+        return pos;
+    };
+    if (compressed_) {
+        EditBlock(FindBlock(ordinal), erase);
+        return true;
+    }
+    RebuildBlocksFrom(erase(ordinals_.Mutable(), term_freqs_.Mutable()));
+    return true;
+}
+
+void PostingList::Renumber(const vector<int>& new_ordinals) {
+    Unpack();
+    for (int& ordinal : ordinals_.Mutable()) {
+        ordinal = new_ordinals[ordinal];
+    }
+    RebuildBlocksFrom(0);
+    Pack();
+}
+
+bool PostingList::Contains(int ordinal) const {
+    const size_t block = FindBlock(ordinal);
+    if (block == GetBlockCount()) {
+        return false;
+    }
+    BlockBuffer buffer;
+    const Block view = GetBlock(block, buffer);
+    return binary_search(view.ordinals, view.ordinals + view.size, ordinal);
+}
+
+void PostingList::SetCompressed(bool compressed) {
+    if (compressed_ == compressed) {
+        return;
+    }
+    Unpack();
+    compressed_ = compressed;
+    Pack();
+}
+
+PostingList::Block PostingList::GetBlock(size_t block, BlockBuffer& buffer) const {
+    if (block >= packed_block_count_) {
+        const size_t first = (block - packed_block_count_) * BLOCK_SIZE;
+        return {ordinals_.data() + first, term_freqs_.data() + first,
+                min(BLOCK_SIZE, ordinals_.size() - first)};
+    }
+
+    const uint32_t* in = packed_.data() + packed_offsets_[block];
+    const uint32_t bit_width = GetBlockBitWidth(in[0]);
+    const size_t size = GetBlockSize(in[0]);
+    int ordinal = static_cast<int>(in[1]) - 1;
+    in += BLOCK_HEADER_WORD_COUNT;
+    uint32_t values[BLOCK_SIZE];
+    UnpackBlock(in, bit_width, values);
+    in += GetPackedWordCount(bit_width);
+    for (size_t i = 0; i < size; ++i) {
+        ordinal += static_cast<int>(values[i]) + 1;
+        buffer.ordinals[i] = ordinal;
+    }
+    const double scale = block_max_term_freqs_[block] / MAX_QUANTIZED_TERM_FREQ;
+    for (size_t i = 0; i < size; ++i) {
+        const uint32_t quantized = in[i / 2] >> (i % 2 * 16) & MAX_QUANTIZED_TERM_FREQ;
+        buffer.term_freqs[i] = quantized * scale;
+    }
+    return {buffer.ordinals, buffer.term_freqs, size};
+}
+
+size_t PostingList::GetMemoryUsage() const {
+    return ordinals_.GetMemoryUsage() + term_freqs_.GetMemoryUsage() + packed_.GetMemoryUsage()
+           + packed_offsets_.GetMemoryUsage() + block_last_ordinals_.GetMemoryUsage()
+           + block_max_term_freqs_.GetMemoryUsage();
+}
+
+void PostingList::Save(SnapshotWriter& writer) const {
+    writer.WriteValue(PostingListHeader{compressed_, packed_block_count_, max_term_freq_});
+    writer.WriteArray(ordinals_);
+    writer.WriteArray(term_freqs_);
+    writer.WriteArray(packed_);
+    writer.WriteArray(packed_offsets_);
+    writer.WriteArray(block_last_ordinals_);
+    writer.WriteArray(block_max_term_freqs_);
+}
+
+PostingList PostingList::Load(SnapshotReader& reader, size_t ordinal_count) {
+    const auto header = reader.ReadValue<PostingListHeader>();
+    PostingList postings(header.compressed != 0);
+    postings.packed_block_count_ = header.packed_block_count;
+    postings.max_term_freq_ = header.max_term_freq;
+    postings.ordinals_ = reader.ReadArray<int>();
+    postings.term_freqs_ = reader.ReadArray<double>();
+    postings.packed_ = reader.ReadArray<uint32_t>();
+    postings.packed_offsets_ = reader.ReadArray<uint64_t>();
+    postings.block_last_ordinals_ = reader.ReadArray<int>();
+    postings.block_max_term_freqs_ = reader.ReadArray<double>();
+
+    // Enough to keep reads of a damaged file inside the arrays
+    const size_t plain_block_count = (postings.ordinals_.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    bool is_valid = postings.term_freqs_.size() == postings.ordinals_.size()
+                    && postings.packed_offsets_.size() == postings.packed_block_count_
+                    && postings.block_last_ordinals_.size() == postings.packed_block_count_ + plain_block_count
+                    && postings.block_max_term_freqs_.size() == postings.block_last_ordinals_.size();
+    for (size_t block = 0; is_valid && block < postings.packed_block_count_; ++block) {
+        const uint64_t offset = postings.packed_offsets_[block];
+        is_valid = offset < postings.packed_.size();
+        if (is_valid) {
+            const uint32_t header = postings.packed_[offset];
+            const size_t size = GetBlockSize(header);
+            is_valid = GetBlockBitWidth(header) <= 32 && size > 0 && size <= BLOCK_SIZE
+                       && postings.packed_.size() - offset
+                              >= BLOCK_HEADER_WORD_COUNT + GetPackedWordCount(GetBlockBitWidth(header)) + TERM_FREQ_WORD_COUNT;
+            postings.packed_size_ += size;
+        }
+    }
+    // Searches index scratch and documents by ordinal and skip by the last
+    // ordinals of blocks, so both are checked once for every posting
+    BlockBuffer buffer;
+    int previous = -1;
+    for (size_t block = 0; is_valid && block < postings.GetBlockCount(); ++block) {
+        const Block view = postings.GetBlock(block, buffer);
+        for (size_t i = 0; is_valid && i < view.size; ++i) {
+            is_valid = view.ordinals[i] > previous && static_cast<size_t>(view.ordinals[i]) < ordinal_count;
+            previous = view.ordinals[i];
+        }
+        is_valid = is_valid && view.size > 0 && postings.block_last_ordinals_[block] == previous;
+    }
+    if (!is_valid) {
+        SnapshotReader::ThrowCorrupted();
+    }
+    return postings;
+}
+
+void PostingList::RebuildBlocksFrom(size_t position) {
+    const size_t block_count = (ordinals_.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    vector<int>& block_last_ordinals = block_last_ordinals_.Mutable();
+    vector<double>& block_max_term_freqs = block_max_term_freqs_.Mutable();
+    block_last_ordinals.resize(block_count);
+    block_max_term_freqs.resize(block_count);
+    for (size_t block = position / BLOCK_SIZE; block < block_count; ++block) {
+        const size_t first = block * BLOCK_SIZE;
+        const size_t last = min(ordinals_.size(), first + BLOCK_SIZE);
+        block_last_ordinals[block] = ordinals_[last - 1];
+        block_max_term_freqs[block] = *max_element(term_freqs_.begin() + first, term_freqs_.begin() + last);
+    }
+    max_term_freq_ = block_max_term_freqs.empty()
+                         ? 0.0
+                         : *max_element(block_max_term_freqs.begin(), block_max_term_freqs.end());
+}
+
+void PostingList::PackTailBlock() {
+    const size_t block = packed_block_count_;
+    vector<uint32_t>& packed = packed_.Mutable();
+    packed_offsets_.Mutable().push_back(packed.size());
+    EncodeBlock(ordinals_.data(), term_freqs_.data(), BLOCK_SIZE, block_max_term_freqs_[block], packed);
+
+    vector<int>& ordinals = ordinals_.Mutable();
+    vector<double>& term_freqs = term_freqs_.Mutable();
+    ordinals.erase(ordinals.begin(), ordinals.begin() + BLOCK_SIZE);
+    term_freqs.erase(term_freqs.begin(), term_freqs.begin() + BLOCK_SIZE);
+    ++packed_block_count_;
+    packed_size_ += BLOCK_SIZE;
+}
+
+template <typename Edit>
+void PostingList::EditBlock(size_t block, Edit edit) {
+    BlockBuffer buffer;
+    const Block view = GetBlock(block, buffer);
+    vector<int> ordinals(view.ordinals, view.ordinals + view.size);
+    vector<double> term_freqs(view.term_freqs, view.term_freqs + view.size);
+    edit(ordinals, term_freqs);
+    if (block < packed_block_count_) {
+        ReplacePackedBlock(block, ordinals, term_freqs);
+    } else {
+        ReplaceTailBlock(ordinals, term_freqs);
+    }
+}
+
+void PostingList::ReplacePackedBlock(size_t block, const vector<int>& ordinals, const vector<double>& term_freqs) {
+    // An insertion into a full block splits it into two halves
+    const size_t block_count = (ordinals.size() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    const double old_block_max = block_max_term_freqs_[block];
+    vector<uint32_t> words;
+    vector<uint64_t> offsets;
+    vector<int> last_ordinals;
+    vector<double> max_term_freqs;
+    for (size_t i = 0; i < block_count; ++i) {
+        const size_t first = ordinals.size() * i / block_count;
+        const size_t last = ordinals.size() * (i + 1) / block_count;
+        // Keeping the old maximum as the scale keeps the quantized frequencies
+        // exact unless one grows past it; the maximum stays an upper bound
+        const double block_max = max(old_block_max, *max_element(term_freqs.begin() + first, term_freqs.begin() + last));
+        offsets.push_back(words.size());
+        EncodeBlock(ordinals.data() + first, term_freqs.data() + first, last - first, block_max, words);
+        last_ordinals.push_back(ordinals[last - 1]);
+        max_term_freqs.push_back(block_max);
+    }
+
+    // Words of the following blocks move, but stay as they were packed
+    vector<uint32_t>& packed = packed_.Mutable();
+    vector<uint64_t>& packed_offsets = packed_offsets_.Mutable();
+    const uint64_t begin = packed_offsets[block];
+    const uint64_t end = block + 1 < packed_block_count_ ? packed_offsets[block + 1] : packed.size();
+    packed_size_ = packed_size_ - GetBlockSize(packed[begin]) + ordinals.size();
+    packed.erase(packed.begin() + begin, packed.begin() + end);
+    packed.insert(packed.begin() + begin, words.begin(), words.end());
+    for (size_t i = block + 1; i < packed_block_count_; ++i) {
+        packed_offsets[i] = packed_offsets[i] - (end - begin) + words.size();
+    }
+    for (uint64_t& offset : offsets) {
+        offset += begin;
+    }
+
+    vector<int>& block_last_ordinals = block_last_ordinals_.Mutable();
+    vector<double>& block_max_term_freqs = block_max_term_freqs_.Mutable();
+    packed_offsets.erase(packed_offsets.begin() + block);
+    packed_offsets.insert(packed_offsets.begin() + block, offsets.begin(), offsets.end());
+    block_last_ordinals.erase(block_last_ordinals.begin() + block);
+    block_last_ordinals.insert(block_last_ordinals.begin() + block, last_ordinals.begin(), last_ordinals.end());
+    block_max_term_freqs.erase(block_max_term_freqs.begin() + block);
+    block_max_term_freqs.insert(block_max_term_freqs.begin() + block, max_term_freqs.begin(), max_term_freqs.end());
+    packed_block_count_ = packed_block_count_ - 1 + block_count;
+    max_term_freq_ = block_max_term_freqs.empty()
+                         ? 0.0
+                         : *max_element(block_max_term_freqs.begin(), block_max_term_freqs.end());
+}
+
+void PostingList::ReplaceTailBlock(const vector<int>& ordinals, const vector<double>& term_freqs) {
+    ordinals_ = {};
+    term_freqs_ = {};
+    block_last_ordinals_.Mutable().pop_back();
+    block_max_term_freqs_.Mutable().pop_back();
+    max_term_freq_ = block_max_term_freqs_.empty()
+                         ? 0.0
+                         : *max_element(block_max_term_freqs_.begin(), block_max_term_freqs_.end());
+    // Appending packs the first BLOCK_SIZE postings once there are more
+    for (size_t i = 0; i < ordinals.size(); ++i) {
+        Add(ordinals[i], term_freqs[i]);
+    }
+}
+
+void PostingList::RemoveFromBlock(size_t block, const vector<int>& removed_ordinals) {
+    EditBlock(block, [&removed_ordinals](vector<int>& ordinals, vector<double>& term_freqs) {
+        size_t kept = 0;
+        for (size_t i = 0; i < ordinals.size(); ++i) {
+            if (!binary_search(removed_ordinals.begin(), removed_ordinals.end(), ordinals[i])) {
+                ordinals[kept] = ordinals[i];
+                term_freqs[kept] = term_freqs[i];
+                ++kept;
+            }
+        }
+        ordinals.resize(kept);
+        term_freqs.resize(kept);
+    });
+}
+
+void PostingList::Pack() {
+    if (!compressed_) {
+        return;
+    }
+    // The last block stays plain
+    while (ordinals_.size() > BLOCK_SIZE) {
+        PackTailBlock();
+    }
+    ordinals_.Mutable().shrink_to_fit();
+    term_freqs_.Mutable().shrink_to_fit();
+}
+
+void PostingList::Unpack() {
+    if (packed_block_count_ == 0) {
+        return;
+    }
+    vector<int> ordinals;
+    vector<double> term_freqs;
+    ordinals.reserve(size());
+    term_freqs.reserve(size());
+    BlockBuffer buffer;
+    for (size_t block = 0; block < GetBlockCount(); ++block) {
+        const Block view = GetBlock(block, buffer);
+        ordinals.insert(ordinals.end(), view.ordinals, view.ordinals + view.size);
+        term_freqs.insert(term_freqs.end(), view.term_freqs, view.term_freqs + view.size);
+    }
+    ordinals_ = ArrayStorage<int>(move(ordinals));
+    term_freqs_ = ArrayStorage<double>(move(term_freqs));
+    packed_block_count_ = 0;
+    packed_size_ = 0;
+    packed_ = {};
+    packed_offsets_ = {};
+    // Packed blocks may be shorter than BLOCK_SIZE, plain ones are not
+    RebuildBlocksFrom(0);
+}
+
+size_t PostingList::FindBlock(int ordinal) const {
+    return lower_bound(block_last_ordinals_.begin(), block_last_ordinals_.end(), ordinal)
+           - block_last_ordinals_.begin();
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include "array_storage.h"
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+class SnapshotReader;
+class SnapshotWriter;
+
+// Postings of a single word: document ordinals and term frequencies sorted by
+// ordinal, so a query scans contiguous memory instead of map nodes.
+// Every BLOCK_SIZE postings form a block whose last ordinal (a skip pointer) and
+// maximum term frequency are kept aside for skipping and dynamic pruning.
+//
+// A compressed list stores every block but the last one bit-packed: ordinals as
+// deltas, term frequencies quantized to 16 bits relative to the block maximum.
+// Blocks are decoded on access into a caller-provided BlockBuffer. The last block
+// stays plain, so appending postings and accumulating the frequency of the last
+// one stay cheap. A change in the middle decodes and repacks only the block it
+// falls in, which may then hold fewer than BLOCK_SIZE postings or be split in
+// two; other blocks keep their packed words and quantized frequencies. A repacked
+// block keeps its maximum as the scale unless a frequency grows past it, so
+// removals leave the remaining frequencies exact and the maximum an upper bound.
+//
+// A list loaded from an index snapshot reads its arrays in place from the mapped
+// file and copies them to the heap only when it is changed.
+class PostingList {
+public:
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    struct BlockBuffer
+    {
+        int ordinals[BLOCK_SIZE];
+        double term_freqs[BLOCK_SIZE];
+    };
+
+    struct Block
+    {
+        const int* ordinals;
+        const double* term_freqs;
+        size_t size;
+    };
+
+    // Walks the postings in ordinal order, decoding one block at a time
+    class Cursor {
+    public:
+        explicit Cursor(const PostingList& postings);
+
+        bool IsAtEnd() const {
+            return block_ == postings_->GetBlockCount();
+        }
+        // INT_MAX once the cursor is at the end
+        int GetOrdinal() const {
+            return IsAtEnd() ? INT_MAX : GetBlock().ordinals[index_];
+        }
+        double GetTermFreq() const {
+            return GetBlock().term_freqs[index_];
+        }
+        int GetBlockLastOrdinal() const {
+            return postings_->block_last_ordinals_[block_];
+        }
+        double GetBlockMaxTermFreq() const {
+            return postings_->block_max_term_freqs_[block_];
+        }
+
+        void Next();
+        // Moves to the first posting whose ordinal is not less than target,
+        // skipping whole blocks by their last ordinals
+        void Seek(int target);
+
+    private:
+        const PostingList* postings_;
+        size_t block_ = 0;
+        size_t index_ = 0;
+        // The block is read in place when it is plain, otherwise from buffer_
+        const int* plain_ordinals_ = nullptr;
+        const double* plain_term_freqs_ = nullptr;
+        size_t block_size_ = 0;
+        BlockBuffer buffer_;
+
+        Block GetBlock() const;
+        void LoadBlock(size_t block);
+    };
+
+    explicit PostingList(bool compressed = false);
+
+    // Adds term_freq to the document's frequency, inserting the ordinal if needed
+    void Add(int ordinal, double term_freq);
+    // Returns false if the ordinal was not in the list
+    bool Remove(int ordinal);
+    // Removes every posting whose ordinal satisfies is_removed in one pass over
+    // the list and returns how many were removed. A compressed list repacks
+    // only the blocks that lose postings
+    template <typename Predicate>
+    size_t RemoveIf(Predicate is_removed);
+    bool Contains(int ordinal) const;
+    // Replaces every ordinal with new_ordinals[ordinal]. The mapping must keep
+    // the order of the ordinals in the list
+    void Renumber(const std::vector<int>& new_ordinals);
+
+    bool IsCompressed() const {
+        return compressed_;
+    }
+    // Packs or unpacks the list. Unpacking keeps the quantized frequencies
+    void SetCompressed(bool compressed);
+
+    size_t GetBlockCount() const {
+        return block_last_ordinals_.size();
+    }
+    // Returns the block, decoding it into buffer if it is packed
+    Block GetBlock(size_t block, BlockBuffer& buffer) const;
+
+    // Calls func(ordinal, term_freq) for every posting with ordinal in [first, last)
+    template <typename Func>
+    void ForEachPosting(int first, int last, Func func) const;
+    template <typename Func>
+    void ForEachPosting(Func func) const {
+        ForEachPosting(INT_MIN, INT_MAX, func);
+    }
+
+    // INT_MIN for an empty list
+    int GetLastOrdinal() const {
+        return block_last_ordinals_.empty() ? INT_MIN : block_last_ordinals_.back();
+    }
+    double GetMaxTermFreq() const {
+        return max_term_freq_;
+    }
+    size_t size() const {
+        return packed_size_ + ordinals_.size();
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    // Heap bytes held by the postings, excluding the object itself
+    size_t GetMemoryUsage() const;
+
+    void Save(SnapshotWriter& writer) const;
+    // The list refers to the reader's mapping, which must outlive it. Ordinals
+    // must ascend and be less than ordinal_count
+    static PostingList Load(SnapshotReader& reader, size_t ordinal_count);
+
+private:
+    bool compressed_;
+    // Plain postings: all of them, or only the last block of a compressed list
+    ArrayStorage<int> ordinals_;
+    ArrayStorage<double> term_freqs_;
+    // Packed blocks stored back to back, see EncodeBlock for the layout
+    size_t packed_block_count_ = 0;
+    size_t packed_size_ = 0;
+    ArrayStorage<uint32_t> packed_;
+    ArrayStorage<uint64_t> packed_offsets_;
+    ArrayStorage<int> block_last_ordinals_;
+    ArrayStorage<double> block_max_term_freqs_;
+    double max_term_freq_ = 0.0;
+
+    // Recomputes skip data of every block from the one holding position; plain lists only
+    void RebuildBlocksFrom(size_t position);
+    // Moves the first BLOCK_SIZE plain postings into a new packed block
+    void PackTailBlock();
+    // Decodes the block, lets edit(ordinals, term_freqs) change its postings
+    // and stores them back; compressed lists only
+    template <typename Edit>
+    void EditBlock(size_t block, Edit edit);
+    // Replaces a packed block with the postings, packed into as many blocks as
+    // they need, possibly none
+    void ReplacePackedBlock(size_t block, const std::vector<int>& ordinals, const std::vector<double>& term_freqs);
+    // Replaces the plain last block with the postings, packing its first
+    // BLOCK_SIZE ones if there are more
+    void ReplaceTailBlock(const std::vector<int>& ordinals, const std::vector<double>& term_freqs);
+    // Removes the ordinals, all of which are in the block; compressed lists only
+    void RemoveFromBlock(size_t block, const std::vector<int>& removed_ordinals);
+    void Pack();
+    void Unpack();
+    size_t FindBlock(int ordinal) const;
+};
+
+template <typename Predicate>
+size_t PostingList::RemoveIf(Predicate is_removed) {
+    if (compressed_) {
+        // Blocks are edited from the last one, so a block that empties does not
+        // shift the ones still to visit
+        size_t removed = 0;
+        BlockBuffer buffer;
+        std::vector<int> block_removed;
+        for (size_t block = GetBlockCount(); block-- > 0;) {
+            const Block view = GetBlock(block, buffer);
+            block_removed.clear();
+            std::copy_if(view.ordinals, view.ordinals + view.size, std::back_inserter(block_removed), is_removed);
+            if (!block_removed.empty()) {
+                RemoveFromBlock(block, block_removed);
+                removed += block_removed.size();
+            }
+        }
+        return removed;
+    }
+    std::vector<int>& ordinals = ordinals_.Mutable();
+    std::vector<double>& term_freqs = term_freqs_.Mutable();
+    size_t kept = 0;
+    size_t first_removed = ordinals.size();
+    for (size_t i = 0; i < ordinals.size(); ++i) {
+        if (is_removed(ordinals[i])) {
+            first_removed = std::min(first_removed, i);
+            continue;
+        }
+        ordinals[kept] = ordinals[i];
+        term_freqs[kept] = term_freqs[i];
+        ++kept;
+    }
+    const size_t removed = ordinals.size() - kept;
+    ordinals.resize(kept);
+    term_freqs.resize(kept);
+    if (removed > 0) {
+        RebuildBlocksFrom(first_removed);
+    }
+    return removed;
+}
+
+template <typename Func>
+void PostingList::ForEachPosting(int first, int last, Func func) const {
+    BlockBuffer buffer;
+    for (size_t block = FindBlock(first); block < GetBlockCount(); ++block) {
+        const Block view = GetBlock(block, buffer);
+        if (view.ordinals[0] >= first && view.ordinals[view.size - 1] < last) {
+            for (size_t i = 0; i < view.size; ++i) {
+                func(view.ordinals[i], view.term_freqs[i]);
+            }
+            continue;
+        }
+        for (size_t i = 0; i < view.size; ++i) {
+            if (view.ordinals[i] >= last) {
+                return;
+            }
+            if (view.ordinals[i] >= first) {
+                func(view.ordinals[i], view.term_freqs[i]);
+            }
+        }
+    }
+}
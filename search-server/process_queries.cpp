@@ -1,29 +1,29 @@
 #include "process_queries.h"
 #include <algorithm>
 #include <execution>
-#include <functional>
 #include <numeric>
-#include <list>
 #include <vector>
 
 std::vector<std::vector<Document>> ProcessQueries(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
-    std::vector<std::vector<Document>> result(queries.size());
-    std::transform(std::execution::par, queries.begin(), queries.end(), result.begin(), [&search_server](const std::string& query){return search_server.FindTopDocuments(query);} );
-    return result;
+    return search_server.FindTopDocumentsBatch(std::execution::par, queries);
 }
 
 std::vector<Document> ProcessQueriesJoined(
     const SearchServer& search_server,
     const std::vector<std::string>& queries) {
-        auto func = [](const std::vector<Document>& lhs, const std::vector<Document>& rhs) {
-            std::vector<Document> result{lhs.begin(), lhs.end()};
-            for (const auto& elem : rhs) {
-                result.push_back(elem);
-            }
-            return result;
-    };
-    std::vector<Document> result = std::transform_reduce(std::execution::par, queries.begin(), queries.end(), std::vector<Document>{}, func, [&search_server](const std::string& query){return search_server.FindTopDocuments(query);} );
-    return result;
-}
\ No newline at end of file
+    const auto results = ProcessQueries(search_server, queries);
+    // Every query's documents are copied once, to its offset in the joined output
+    std::vector<size_t> offsets(results.size() + 1, 0);
+    for (size_t i = 0; i < results.size(); ++i) {
+        offsets[i + 1] = offsets[i] + results[i].size();
+    }
+    std::vector<Document> joined(offsets.back());
+    std::vector<size_t> indexes(results.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    std::for_each(std::execution::par, indexes.begin(), indexes.end(), [&](size_t i) {
+        std::copy(results[i].begin(), results[i].end(), joined.begin() + offsets[i]);
+    });
+    return joined;
+}
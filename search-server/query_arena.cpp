@@ -0,0 +1,63 @@
+#include "query_arena.h"
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+QueryArena::Scope::Scope(QueryArena& arena)
+    : arena_(arena)
+    , chunk_(arena.chunk_)
+    , offset_(arena.offset_) {
+}
+
+QueryArena::Scope::~Scope() {
+    arena_.chunk_ = chunk_;
+    arena_.offset_ = offset_;
+}
+
+QueryArena& QueryArena::ForCurrentThread() {
+    static thread_local QueryArena arena;
+    return arena;
+}
+
+size_t QueryArena::GetMemoryUsage() const {
+    size_t usage = chunks_.capacity() * sizeof(Chunk);
+    for (const Chunk& chunk : chunks_) {
+        usage += chunk.size;
+    }
+    return usage;
+}
+
+void* QueryArena::AllocateInCurrentChunk(size_t bytes, size_t alignment) {
+    Chunk& chunk = chunks_[chunk_];
+    const uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data.get());
+    const size_t begin = ((base + offset_ + alignment - 1) & ~(uintptr_t{alignment} - 1)) - base;
+    if (begin > chunk.size || chunk.size - begin < bytes) {
+        return nullptr;
+    }
+    offset_ = begin + bytes;
+    return chunk.data.get() + begin;
+}
+
+void* QueryArena::do_allocate(size_t bytes, size_t alignment) {
+    if (!chunks_.empty()) {
+        if (void* memory = AllocateInCurrentChunk(bytes, alignment)) {
+            return memory;
+        }
+    }
+
+    // Chunks after the current one hold no live memory, so a chunk too small
+    // for the request is replaced by a larger one
+    const size_t next = chunks_.empty() ? 0 : chunk_ + 1;
+    const size_t required = bytes + alignment;
+    if (next == chunks_.size()) {
+        const size_t size = max({MIN_CHUNK_SIZE, required, chunks_.empty() ? 0 : 2 * chunks_.back().size});
+        chunks_.push_back({make_unique<byte[]>(size), size});
+    } else if (chunks_[next].size < required) {
+        const size_t size = max(required, 2 * chunks_[next].size);
+        chunks_[next] = {make_unique<byte[]>(size), size};
+    }
+    chunk_ = next;
+    offset_ = 0;
+    return AllocateInCurrentChunk(bytes, alignment);
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Scratch memory of the queries run on one thread. Query containers take
+// memory through the std::pmr interface from chunks the arena keeps, and a
+// Scope hands everything allocated during its lifetime back at once. Chunks
+// survive the scope, so once they have grown to fit the largest query, a
+// query does not allocate from the heap. Scopes nest: a query a thread runs
+// while it waits inside another one cannot release memory still in use.
+class QueryArena : public std::pmr::memory_resource {
+public:
+    class Scope {
+    public:
+        explicit Scope(QueryArena& arena);
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope();
+
+    private:
+        QueryArena& arena_;
+        size_t chunk_;
+        size_t offset_;
+    };
+
+    // Arena of the calling thread, reused by every query run on it
+    static QueryArena& ForCurrentThread();
+
+    QueryArena() = default;
+    QueryArena(const QueryArena&) = delete;
+    QueryArena& operator=(const QueryArena&) = delete;
+
+    // Heap bytes held by the chunks
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t MIN_CHUNK_SIZE = 16 * 1024;
+
+    struct Chunk {
+        std::unique_ptr<std::byte[]> data;
+        size_t size = 0;
+    };
+
+    std::vector<Chunk> chunks_;
+    // The next allocation starts at offset_ in chunks_[chunk_]
+    size_t chunk_ = 0;
+    size_t offset_ = 0;
+
+    void* AllocateInCurrentChunk(size_t bytes, size_t alignment);
+
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    // Memory is released by Scope only
+    void do_deallocate(void*, size_t, size_t) override {
+    }
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+};
@@ -0,0 +1,55 @@
+#include "query_result_cache.h"
+#include <algorithm>
+#include <functional>
+
+using namespace std;
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+    : capacity_(capacity)
+    , shards_(max<size_t>(1, min(shard_count, capacity))) {
+    shard_capacity_ = max<size_t>(1, (capacity + shards_.size() - 1) / shards_.size());
+}
+
+optional<vector<Document>> QueryResultCache::Find(const string& key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    const auto it = shard.positions.find(key);
+    if (it == shard.positions.end()) {
+        misses_.fetch_add(1, memory_order_relaxed);
+        return nullopt;
+    }
+    if (it->second->generation != generation) {
+        shard.entries.erase(it->second);
+        shard.positions.erase(it);
+        misses_.fetch_add(1, memory_order_relaxed);
+        return nullopt;
+    }
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    hits_.fetch_add(1, memory_order_relaxed);
+    return it->second->documents;
+}
+
+void QueryResultCache::Insert(const string& key, uint64_t generation, vector<Document> documents) {
+    Shard& shard = GetShard(key);
+    lock_guard lock(shard.mutex);
+    if (const auto it = shard.positions.find(key); it != shard.positions.end()) {
+        it->second->generation = generation;
+        it->second->documents = move(documents);
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    if (shard.entries.size() == shard_capacity_) {
+        shard.positions.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({key, generation, move(documents)});
+    shard.positions.emplace(key, shard.entries.begin());
+}
+
+QueryCacheStats QueryResultCache::GetStats() const {
+    return {hits_.load(memory_order_relaxed), misses_.load(memory_order_relaxed)};
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const string& key) {
+    return shards_[hash<string>{}(key) % shards_.size()];
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "document.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+};
+
+// LRU cache of search results split into independently locked shards, so
+// concurrent queries rarely wait for each other. Every entry is tagged with
+// the index generation it was computed for and is never returned for another
+class QueryResultCache {
+public:
+    static constexpr size_t DEFAULT_SHARD_COUNT = 16;
+
+    // Holds about capacity results in total
+    explicit QueryResultCache(size_t capacity, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    // Counts a hit or a miss; an entry of another generation is dropped
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t generation);
+    void Insert(const std::string& key, uint64_t generation, std::vector<Document> documents);
+
+    size_t GetCapacity() const {
+        return capacity_;
+    }
+    QueryCacheStats GetStats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // Most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> positions;
+    };
+
+    size_t capacity_;
+    std::vector<Shard> shards_;
+    size_t shard_capacity_;
+    std::atomic<uint64_t> hits_ = 0;
+    std::atomic<uint64_t> misses_ = 0;
+
+    Shard& GetShard(const std::string& key);
+};
@@ -0,0 +1,448 @@
+#include "query_service.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <exception>
+#include <execution>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// epoll data of the descriptors that are not connections
+constexpr uint64_t STOP_EVENT = UINT64_MAX;
+constexpr uint64_t LISTENER_TAG = uint64_t{1} << 63;
+
+// A connection sending a longer line is answered with an error and closed
+constexpr size_t MAX_REQUEST_SIZE = 64 * 1024;
+// Connections with more unsent responses are not read from
+constexpr size_t MAX_OUTPUT_SIZE = 1024 * 1024;
+constexpr size_t READ_SIZE = 64 * 1024;
+constexpr int MAX_EVENTS = 64;
+
+const array<string_view, 4> STATUS_NAMES = {"ACTUAL", "IRRELEVANT", "BANNED", "REMOVED"};
+
+[[noreturn]] void ThrowSystemError(const string& what) {
+    throw runtime_error(what + ": "s + strerror(errno));
+}
+
+void AppendNumber(string& out, double value) {
+    char buffer[32];
+    const auto result = to_chars(begin(buffer), end(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+void AppendNumber(string& out, int value) {
+    char buffer[16];
+    const auto result = to_chars(begin(buffer), end(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+string FormatError(const exception& error) {
+    string response = "ERROR "s + error.what();
+    replace(response.begin(), response.end(), '\n', ' ');
+    return response;
+}
+
+string FormatDocuments(const vector<Document>& documents) {
+    string response = "OK ";
+    AppendNumber(response, static_cast<int>(documents.size()));
+    for (const Document& document : documents) {
+        response.push_back(' ');
+        AppendNumber(response, document.id);
+        response.push_back(' ');
+        AppendNumber(response, document.relevance);
+        response.push_back(' ');
+        AppendNumber(response, document.rating);
+    }
+    return response;
+}
+
+string ExecuteMatch(const SearchServer& search_server, string_view arguments) {
+    const size_t space = arguments.find(' ');
+    const string_view id_text = arguments.substr(0, space);
+    int document_id = 0;
+    const auto parsed = from_chars(id_text.data(), id_text.data() + id_text.size(), document_id);
+    if (id_text.empty() || parsed.ec != errc() || parsed.ptr != id_text.data() + id_text.size()) {
+        return "ERROR Invalid document id";
+    }
+    const string_view query = space == string_view::npos ? string_view() : arguments.substr(space + 1);
+    const auto [words, status] = search_server.MatchDocument(query, document_id);
+    string response = "OK ";
+    response += STATUS_NAMES.at(static_cast<size_t>(status));
+    for (const string_view word : words) {
+        response.push_back(' ');
+        response += word;
+    }
+    return response;
+}
+
+}  // namespace
+
+QueryService::QueryService(const SearchServer& search_server, QueryServiceOptions options)
+    : search_server_(search_server)
+    , options_(options) {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        ThrowSystemError("Cannot create an epoll instance");
+    }
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (stop_fd_ < 0) {
+        close(epoll_fd_);
+        ThrowSystemError("Cannot create an eventfd");
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = STOP_EVENT;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, stop_fd_, &event);
+}
+
+QueryService::~QueryService() {
+    for (const auto& [id, connection] : connections_) {
+        close(connection.fd);
+    }
+    for (const int fd : listen_fds_) {
+        close(fd);
+    }
+    for (const string& path : unix_paths_) {
+        unlink(path.c_str());
+    }
+    close(stop_fd_);
+    close(epoll_fd_);
+}
+
+void QueryService::ListenTcp(uint16_t port) {
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("Cannot create a TCP socket");
+    }
+    const int enable = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    socklen_t address_size = sizeof(address);
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0
+        || listen(fd, SOMAXCONN) < 0
+        || getsockname(fd, reinterpret_cast<sockaddr*>(&address), &address_size) < 0) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("Cannot listen on TCP port "s + to_string(port));
+    }
+    tcp_port_ = ntohs(address.sin_port);
+    AddListener(fd);
+}
+
+uint16_t QueryService::GetTcpPort() const {
+    return tcp_port_;
+}
+
+void QueryService::ListenUnix(const string& path) {
+    sockaddr_un address{};
+    if (path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("Unix socket path is too long: "s + path);
+    }
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        ThrowSystemError("Cannot create a Unix socket");
+    }
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    if (bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("Cannot listen on "s + path);
+    }
+    unix_paths_.push_back(path);
+    AddListener(fd);
+}
+
+void QueryService::AddListener(int fd) {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = LISTENER_TAG | static_cast<uint64_t>(fd);
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+        const int error = errno;
+        close(fd);
+        errno = error;
+        ThrowSystemError("Cannot watch a listening socket");
+    }
+    listen_fds_.push_back(fd);
+}
+
+void QueryService::Stop() {
+    // write is async-signal-safe
+    const uint64_t one = 1;
+    [[maybe_unused]] const ssize_t written = write(stop_fd_, &one, sizeof(one));
+}
+
+void QueryService::Run() {
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        int timeout = -1;
+        if (!pending_.empty()) {
+            const auto remaining = chrono::ceil<chrono::milliseconds>(batch_deadline_ - chrono::steady_clock::now());
+            timeout = static_cast<int>(max<chrono::milliseconds::rep>(0, remaining.count()));
+        }
+        const int event_count = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+        if (event_count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ThrowSystemError("epoll_wait failed");
+        }
+        for (int i = 0; i < event_count; ++i) {
+            const uint64_t data = events[i].data.u64;
+            if (data == STOP_EVENT) {
+                uint64_t count = 0;
+                [[maybe_unused]] const ssize_t read_size = read(stop_fd_, &count, sizeof(count));
+                return;
+            }
+            if (data & LISTENER_TAG) {
+                AcceptConnections(static_cast<int>(data & ~LISTENER_TAG));
+                continue;
+            }
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                ReadRequests(data);
+            }
+            if (events[i].events & EPOLLOUT) {
+                WriteResponses(data);
+            }
+        }
+        if (!pending_.empty() && (event_count == 0 || chrono::steady_clock::now() >= batch_deadline_)) {
+            ExecutePending();
+        }
+    }
+}
+
+void QueryService::AcceptConnections(int listen_fd) {
+    while (true) {
+        const int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            // EAGAIN once the backlog is drained; other errors concern only
+            // the connection being accepted
+            return;
+        }
+        const int enable = 1;
+        // Fails harmlessly on Unix sockets
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        const uint64_t id = next_connection_id_++;
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = id;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            close(fd);
+            continue;
+        }
+        connections_[id].fd = fd;
+    }
+}
+
+void QueryService::ReadRequests(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end() || !it->second.is_reading) {
+        return;
+    }
+    Connection& connection = it->second;
+    const size_t old_size = connection.input.size();
+    connection.input.resize(old_size + READ_SIZE);
+    const ssize_t read_size = read(connection.fd, connection.input.data() + old_size, READ_SIZE);
+    connection.input.resize(old_size + max<ssize_t>(read_size, 0));
+    if (read_size < 0) {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            CloseConnection(connection_id);
+        }
+        return;
+    }
+    if (read_size == 0) {
+        // A trailing request without a line break is dropped
+        connection.is_reading = false;
+        connection.is_closing = true;
+        connection.input.clear();
+        UpdateConnection(connection_id);
+        return;
+    }
+
+    size_t line_start = 0;
+    for (size_t line_end; (line_end = connection.input.find('\n', line_start)) != string::npos; line_start = line_end + 1) {
+        size_t line_size = line_end - line_start;
+        if (line_size > 0 && connection.input[line_end - 1] == '\r') {
+            --line_size;
+        }
+        if (pending_.empty()) {
+            batch_deadline_ = chrono::steady_clock::now() + options_.batch_delay;
+        }
+        pending_.push_back({connection_id, connection.input.substr(line_start, line_size), nullopt});
+        ++connection.pending_count;
+    }
+    connection.input.erase(0, line_start);
+    if (connection.input.size() > MAX_REQUEST_SIZE) {
+        connection.input.clear();
+        // Answered after the requests read before it
+        if (pending_.empty()) {
+            batch_deadline_ = chrono::steady_clock::now() + options_.batch_delay;
+        }
+        pending_.push_back({connection_id, string(), "ERROR Request is too long"s});
+        ++connection.pending_count;
+        connection.is_reading = false;
+        connection.is_closing = true;
+    }
+    UpdateConnection(connection_id);
+    if (pending_.size() >= options_.max_batch_size) {
+        ExecutePending();
+    }
+}
+
+void QueryService::WriteResponses(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    Connection& connection = it->second;
+    while (connection.output_offset < connection.output.size()) {
+        const ssize_t written = send(connection.fd, connection.output.data() + connection.output_offset,
+                                     connection.output.size() - connection.output_offset, MSG_NOSIGNAL);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                CloseConnection(connection_id);
+                return;
+            }
+            break;
+        }
+        connection.output_offset += static_cast<size_t>(written);
+    }
+    if (connection.output_offset == connection.output.size()) {
+        connection.output.clear();
+        connection.output_offset = 0;
+    }
+    UpdateConnection(connection_id);
+}
+
+void QueryService::ExecutePending() {
+    vector<uint64_t> answered;
+    const size_t batch_size = max<size_t>(1, options_.max_batch_size);
+    for (size_t first = 0; first < pending_.size(); first += batch_size) {
+        const size_t last = min(pending_.size(), first + batch_size);
+        vector<string> requests;
+        requests.reserve(last - first);
+        for (size_t i = first; i < last; ++i) {
+            if (!pending_[i].response) {
+                requests.push_back(move(pending_[i].line));
+            }
+        }
+        vector<string> responses = ExecuteRequests(search_server_, requests);
+        for (size_t i = first, executed = 0; i < last; ++i) {
+            if (!pending_[i].response) {
+                pending_[i].response = move(responses[executed++]);
+            }
+        }
+        for (size_t i = first; i < last; ++i) {
+            const auto it = connections_.find(pending_[i].connection_id);
+            if (it == connections_.end()) {
+                continue;
+            }
+            Connection& connection = it->second;
+            if (connection.output.empty()) {
+                answered.push_back(pending_[i].connection_id);
+            }
+            connection.output += *pending_[i].response;
+            connection.output.push_back('\n');
+            --connection.pending_count;
+        }
+    }
+    pending_.clear();
+    for (const uint64_t connection_id : answered) {
+        WriteResponses(connection_id);
+    }
+}
+
+void QueryService::UpdateConnection(uint64_t connection_id) {
+    Connection& connection = connections_.at(connection_id);
+    const bool has_output = connection.output_offset < connection.output.size();
+    if (connection.is_closing && !has_output && connection.pending_count == 0) {
+        CloseConnection(connection_id);
+        return;
+    }
+    if (!connection.is_closing) {
+        connection.is_reading = connection.output.size() - connection.output_offset <= MAX_OUTPUT_SIZE;
+    }
+    epoll_event event{};
+    event.events = 0;
+    if (connection.is_reading) {
+        event.events |= EPOLLIN;
+    }
+    if (has_output) {
+        event.events |= EPOLLOUT;
+    }
+    event.data.u64 = connection_id;
+    epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, connection.fd, &event);
+}
+
+void QueryService::CloseConnection(uint64_t connection_id) {
+    const auto it = connections_.find(connection_id);
+    if (it == connections_.end()) {
+        return;
+    }
+    // Closing the descriptor removes it from the epoll set
+    close(it->second.fd);
+    connections_.erase(it);
+}
+
+vector<string> QueryService::ExecuteRequests(const SearchServer& search_server, const vector<string>& requests) {
+    vector<string> responses(requests.size());
+    vector<size_t> find_indexes;
+    vector<string> find_queries;
+    // Requests run one by one, in parallel
+    vector<size_t> single_indexes;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        const string_view request = requests[i];
+        if (request.substr(0, 5) == "FIND ") {
+            find_indexes.push_back(i);
+            find_queries.emplace_back(request.substr(5));
+        } else if (request.substr(0, 6) == "MATCH ") {
+            single_indexes.push_back(i);
+        } else {
+            responses[i] = "ERROR Unknown request";
+        }
+    }
+
+    // The batch fails as a whole on the first invalid query, which then gets
+    // its error from a search of its own
+    try {
+        const vector<vector<Document>> results = search_server.FindTopDocumentsBatch(execution::par, find_queries);
+        for (size_t i = 0; i < find_indexes.size(); ++i) {
+            responses[find_indexes[i]] = FormatDocuments(results[i]);
+        }
+    } catch (const exception&) {
+        single_indexes.insert(single_indexes.end(), find_indexes.begin(), find_indexes.end());
+    }
+
+    for_each(execution::par, single_indexes.begin(), single_indexes.end(), [&](size_t i) {
+        const string_view request = requests[i];
+        try {
+            responses[i] = request.substr(0, 5) == "FIND "
+                               ? FormatDocuments(search_server.FindTopDocuments(request.substr(5)))
+                               : ExecuteMatch(search_server, request.substr(6));
+        } catch (const exception& error) {
+            responses[i] = FormatError(error);
+        }
+    });
+    return responses;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "search_server.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct QueryServiceOptions {
+    // Requests executed together at most
+    size_t max_batch_size = 256;
+    // How long requests wait for more to batch with; 0 runs every batch as
+    // soon as the ready sockets are drained
+    std::chrono::milliseconds batch_delay{0};
+};
+
+// Serves a SearchServer over loopback TCP and Unix sockets from one thread
+// running a non-blocking epoll loop.
+//
+// Requests and responses are text lines; a client may send several requests
+// without waiting and gets the responses in request order:
+//   FIND <query>             OK <count> <id> <relevance> <rating> ...
+//   MATCH <id> <query>       OK <status> <word> ...
+// A request that fails gets "ERROR <message>" instead.
+//
+// Requests read from all sockets in one round of the loop form a batch:
+// FIND requests go through FindTopDocumentsBatch, MATCH requests run in
+// parallel, and the loop goes on once the responses are queued. A client
+// that does not read its responses is not read from until it does.
+class QueryService {
+public:
+    // The server must outlive the service and must not change while it runs
+    QueryService(const SearchServer& search_server, QueryServiceOptions options);
+    QueryService(const QueryService&) = delete;
+    QueryService& operator=(const QueryService&) = delete;
+    ~QueryService();
+
+    // Listens on 127.0.0.1; port 0 picks a free port. Throws std::runtime_error
+    // if the socket cannot be set up
+    void ListenTcp(uint16_t port);
+    // The port of the last ListenTcp
+    uint16_t GetTcpPort() const;
+    // Replaces a file left at the path. Throws std::runtime_error if the socket
+    // cannot be set up
+    void ListenUnix(const std::string& path);
+
+    // Serves until Stop is called
+    void Run();
+    // Safe to call from any thread and from a signal handler
+    void Stop();
+
+    // One response line per request line, without line breaks
+    static std::vector<std::string> ExecuteRequests(const SearchServer& search_server,
+                                                    const std::vector<std::string>& requests);
+
+private:
+    struct Connection {
+        int fd = -1;
+        std::string input;
+        std::string output;
+        size_t output_offset = 0;
+        // Requests of the connection waiting in pending_
+        size_t pending_count = 0;
+        bool is_reading = true;
+        // The peer stopped sending; closed once all responses are written
+        bool is_closing = false;
+    };
+    struct PendingRequest {
+        uint64_t connection_id;
+        std::string line;
+        // Set for a request answered without running it, which still waits
+        // its turn behind the earlier requests of the connection
+        std::optional<std::string> response;
+    };
+
+    const SearchServer& search_server_;
+    const QueryServiceOptions options_;
+    int epoll_fd_ = -1;
+    int stop_fd_ = -1;
+    std::vector<int> listen_fds_;
+    std::vector<std::string> unix_paths_;
+    uint16_t tcp_port_ = 0;
+    // Keyed by id rather than descriptor, so responses never reach a
+    // connection that reused the descriptor of a closed one
+    std::unordered_map<uint64_t, Connection> connections_;
+    uint64_t next_connection_id_ = 0;
+    std::vector<PendingRequest> pending_;
+    std::chrono::steady_clock::time_point batch_deadline_;
+
+    void AddListener(int fd);
+    void AcceptConnections(int listen_fd);
+    void ReadRequests(uint64_t connection_id);
+    void WriteResponses(uint64_t connection_id);
+    void ExecutePending();
+    // Registers the events the connection waits for, or closes it
+    void UpdateConnection(uint64_t connection_id);
+    void CloseConnection(uint64_t connection_id);
+};
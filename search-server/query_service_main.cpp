@@ -0,0 +1,76 @@
+// Serves an index snapshot written by SearchServer::SaveIndex, see
+// query_service.h for the protocol.
+//
+// Usage: query_service index=<snapshot> [port=<tcp port>] [socket=<unix socket path>]
+//                      [max_batch=256] [batch_delay_ms=0]
+//
+// Listens on 127.0.0.1:port, on the Unix socket, or on both, until SIGINT or SIGTERM.
+
+#include "query_service.h"
+#include "search_server.h"
+
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace std;
+
+namespace {
+
+QueryService* running_service = nullptr;
+
+void StopService(int) {
+    running_service->Stop();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    map<string, string> options = {{"max_batch", "256"}, {"batch_delay_ms", "0"}};
+    for (int i = 1; i < argc; ++i) {
+        const string argument = argv[i];
+        const size_t equals = argument.find('=');
+        if (equals == string::npos) {
+            cerr << "Expected key=value, got " << argument << endl;
+            return 1;
+        }
+        options[argument.substr(0, equals)] = argument.substr(equals + 1);
+    }
+    if (options.count("index") == 0 || (options.count("port") == 0 && options.count("socket") == 0)) {
+        cerr << "Usage: query_service index=<snapshot> [port=<tcp port>] [socket=<unix socket path>]"
+                " [max_batch=256] [batch_delay_ms=0]" << endl;
+        return 1;
+    }
+
+    try {
+        const SearchServer search_server = SearchServer::LoadIndex(options.at("index"));
+        QueryServiceOptions service_options;
+        service_options.max_batch_size = stoul(options.at("max_batch"));
+        service_options.batch_delay = chrono::milliseconds(stol(options.at("batch_delay_ms")));
+        QueryService service(search_server, service_options);
+        if (options.count("port")) {
+            service.ListenTcp(static_cast<uint16_t>(stoul(options.at("port"))));
+            cerr << "Listening on 127.0.0.1:" << service.GetTcpPort() << endl;
+        }
+        if (options.count("socket")) {
+            service.ListenUnix(options.at("socket"));
+            cerr << "Listening on " << options.at("socket") << endl;
+        }
+        cerr << "Serving " << search_server.GetDocumentCount() << " documents" << endl;
+
+        running_service = &service;
+        signal(SIGINT, StopService);
+        signal(SIGTERM, StopService);
+        service.Run();
+        signal(SIGINT, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        running_service = nullptr;
+    } catch (const exception& error) {
+        cerr << error.what() << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,35 +1,40 @@
 #include "remove_duplicates.h"
 #include "search_server.h"
+#include <algorithm>
 #include <iostream>
-#include <map>
-#include <set>
+#include <unordered_set>
+#include <vector>
 
 using namespace std;
 
-void RemoveDuplicates(SearchServer& search_server) {
-    vector<int> ids_to_delete;
-    map<set<string>, int> words_to_ids;
-    for (const int document_id : search_server) {
-        set<string> words;
-        for (const auto& [word, frequency] : search_server.GetWordFrequencies(document_id)) {
-            words.insert(word);
-        }
-        if (words_to_ids.count(words) != 0) {
-            if (words_to_ids.at(words) > document_id) {
-                ids_to_delete.push_back(words_to_ids.at(words));
-                words_to_ids[words] = document_id;
-            }
-            else {
-                ids_to_delete.push_back(document_id);
-            }
+template <typename Policy>
+static void RemoveDuplicatesImpl(const Policy& policy, SearchServer& search_server) {
+    const vector<int> document_ids(search_server.begin(), search_server.end());
+    vector<DocumentFingerprint> fingerprints(document_ids.size());
+    transform(policy, document_ids.begin(), document_ids.end(), fingerprints.begin(), [&search_server](int document_id) {
+        return search_server.GetDocumentFingerprint(document_id);
+    });
+
+    // Ids are visited in ascending order, so the document kept is the one with the smallest id
+    unordered_set<DocumentFingerprint, DocumentFingerprintHash> seen_fingerprints;
+    vector<int> duplicate_ids;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        if (!seen_fingerprints.insert(fingerprints[i]).second) {
+            cout << "Found duplicate document id " << document_ids[i] << endl;
+            duplicate_ids.push_back(document_ids[i]);
         }
-        else {
-            words_to_ids[words] = document_id;
-        } 
-        
-    }
-    for (const int id : ids_to_delete) {
-        cout << "Found duplicate document id " << id << endl;
-        search_server.RemoveDocument(id);
     }
-}
\ No newline at end of file
+    search_server.RemoveDocuments(policy, duplicate_ids);
+}
+
+void RemoveDuplicates(SearchServer& search_server) {
+    RemoveDuplicatesImpl(execution::seq, search_server);
+}
+
+void RemoveDuplicates(execution::sequenced_policy policy, SearchServer& search_server) {
+    RemoveDuplicatesImpl(policy, search_server);
+}
+
+void RemoveDuplicates(execution::parallel_policy policy, SearchServer& search_server) {
+    RemoveDuplicatesImpl(policy, search_server);
+}
@@ -1,4 +1,11 @@
 #pragma once
 #include "search_server.h"
 
-void RemoveDuplicates(SearchServer& search_server);
\ No newline at end of file
+#include <execution>
+
+// Removes every document whose set of words equals that of a document with a
+// smaller id. Documents are compared by fingerprint; the parallel version
+// computes fingerprints and removes documents on several threads
+void RemoveDuplicates(SearchServer& search_server);
+void RemoveDuplicates(std::execution::sequenced_policy policy, SearchServer& search_server);
+void RemoveDuplicates(std::execution::parallel_policy policy, SearchServer& search_server);
@@ -1,43 +1,133 @@
 #include "request_queue.h"
 #include "search_server.h"
+#include <algorithm>
 #include <string>
 #include <vector>
 
 using namespace std;
 
-RequestQueue::RequestQueue(const SearchServer& search_server)
+namespace {
+
+size_t GetThreadShard(size_t shard_count) {
+    static atomic<size_t> next_thread = 0;
+    static thread_local const size_t thread_number = next_thread.fetch_add(1, memory_order_relaxed);
+    return thread_number % shard_count;
+}
+
+}  // namespace
+
+RequestQueue::RequestQueue(const SearchServer& search_server, Clock::duration history_duration,
+                           Clock::duration bucket_duration)
     : search_server_(search_server)
-    , no_results_requests_(0)
-    , current_time_(0) {
+    , start_(Clock::now())
+    , bucket_duration_(max(bucket_duration, Clock::duration(1)))
+    , history_(max<size_t>(1, (history_duration + bucket_duration_ - Clock::duration(1)) / bucket_duration_)) {
 }
 
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query, DocumentStatus status) {
+    const auto start = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, status);
-    AddRequest(result.size());
+    const auto finish = Clock::now();
+    Record(finish, finish - start, result.size());
     return result;
 }
+
 vector<Document> RequestQueue::AddFindRequest(const string& raw_query) {
+    const auto start = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query);
-    AddRequest(result.size());
+    const auto finish = Clock::now();
+    Record(finish, finish - start, result.size());
     return result;
 }
+
+void RequestQueue::RecordRequest(Clock::duration latency, size_t result_count) {
+    Record(Clock::now(), latency, result_count);
+}
+
 int RequestQueue::GetNoResultRequests() const {
-    return no_results_requests_;
+    return static_cast<int>(GetStats().no_result_count);
+}
+
+RequestStats RequestQueue::GetStats() const {
+    return GetStats(bucket_duration_ * history_.size());
 }
 
-void RequestQueue::AddRequest(int results_num) {
-    // новый запрос - новая секунда
-    ++current_time_;
-    // удаляем все результаты поиска, которые устарели
-    while (!requests_.empty() && min_in_day_ <= current_time_ - requests_.front().timestamp) {
-        if (0 == requests_.front().results) {
-            --no_results_requests_;
+RequestStats RequestQueue::GetStats(Clock::duration window) const {
+    lock_guard lock(history_mutex_);
+    // Taken under the lock, so no shard has been moved to a later bucket
+    const uint64_t current_bucket = GetBucket(Clock::now());
+    RequestStats stats;
+    for (Shard& shard : shards_) {
+        FlushShard(shard, current_bucket);
+        stats.request_count += shard.request_count.load(memory_order_relaxed);
+        stats.no_result_count += shard.no_result_count.load(memory_order_relaxed);
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            if (const uint64_t count = shard.latencies[i].load(memory_order_relaxed)) {
+                stats.latencies.Add(i, count);
+            }
+        }
+    }
+
+    const uint64_t window_buckets = min<uint64_t>(history_.size(), (window + bucket_duration_ - Clock::duration(1)) / bucket_duration_);
+    for (uint64_t age = 1; age < window_buckets && age <= current_bucket; ++age) {
+        const Bucket& bucket = history_[(current_bucket - age) % history_.size()];
+        if (bucket.bucket == current_bucket - age) {
+            stats.request_count += bucket.stats.request_count;
+            stats.no_result_count += bucket.stats.no_result_count;
+            stats.latencies.Merge(bucket.stats.latencies);
         }
-        requests_.pop_front();
     }
-    // сохраняем новый результат поиска
-    requests_.push_back({current_time_, results_num});
-    if (0 == results_num) {
-        ++no_results_requests_;
+    return stats;
+}
+
+uint64_t RequestQueue::GetBucket(Clock::time_point time) const {
+    return static_cast<uint64_t>((time - start_) / bucket_duration_);
+}
+
+void RequestQueue::Record(Clock::time_point finish, Clock::duration latency, size_t result_count) {
+    const uint64_t bucket = GetBucket(finish);
+    Shard& shard = shards_[GetThreadShard(SHARD_COUNT)];
+    if (shard.bucket.load(memory_order_acquire) < bucket) {
+        lock_guard lock(history_mutex_);
+        FlushShard(shard, bucket);
     }
-}
\ No newline at end of file
+    shard.request_count.fetch_add(1, memory_order_relaxed);
+    if (result_count == 0) {
+        shard.no_result_count.fetch_add(1, memory_order_relaxed);
+    }
+    const auto microseconds = chrono::duration_cast<chrono::microseconds>(latency).count();
+    shard.latencies[LatencyHistogram::GetBucketIndex(static_cast<uint64_t>(max<decltype(microseconds)>(0, microseconds)))]
+        .fetch_add(1, memory_order_relaxed);
+}
+
+void RequestQueue::FlushShard(Shard& shard, uint64_t bucket) const {
+    const uint64_t shard_bucket = shard.bucket.load(memory_order_relaxed);
+    if (shard_bucket >= bucket) {
+        return;
+    }
+    // Counts added while the shard is moved go to the new bucket; each is counted once
+    const uint64_t request_count = shard.request_count.exchange(0, memory_order_relaxed);
+    if (request_count != 0) {
+        Bucket& past = history_[shard_bucket % history_.size()];
+        // A shard idle for longer than the history has nothing left to keep
+        const bool is_kept = past.bucket == NO_BUCKET || past.bucket <= shard_bucket;
+        if (is_kept && past.bucket != shard_bucket) {
+            past.bucket = shard_bucket;
+            past.stats.request_count = 0;
+            past.stats.no_result_count = 0;
+            past.stats.latencies.Clear();
+        }
+        const uint64_t no_result_count = shard.no_result_count.exchange(0, memory_order_relaxed);
+        if (is_kept) {
+            past.stats.request_count += request_count;
+            past.stats.no_result_count += no_result_count;
+        }
+        for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; ++i) {
+            const uint64_t count = shard.latencies[i].exchange(0, memory_order_relaxed);
+            if (count != 0 && is_kept) {
+                past.stats.latencies.Add(i, count);
+            }
+        }
+    }
+    shard.bucket.store(bucket, memory_order_release);
+}
@@ -1,35 +1,93 @@
 #pragma once
+#include "latency_histogram.h"
 #include "search_server.h"
-#include <deque>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
 #include <string>
 #include <vector>
 
+struct RequestStats {
+    uint64_t request_count = 0;
+    uint64_t no_result_count = 0;
+    // Latencies in microseconds
+    LatencyHistogram latencies;
+
+    std::chrono::microseconds GetLatencyPercentile(double percentile) const {
+        return std::chrono::microseconds(latencies.GetValueAtPercentile(percentile));
+    }
+};
+
+// Statistics of search requests over a sliding window of wall-clock time,
+// safe to share between threads. Time is split into buckets of
+// bucket_duration, and history_duration of them are kept. A request is
+// counted with relaxed atomic additions in the current bucket of one of
+// several shards, chosen per thread, so recording threads rarely share cache
+// lines and never wait for each other except once per bucket and shard, when
+// the shard is moved into the history. A request finishing on a bucket
+// boundary may be counted in the next bucket.
 class RequestQueue {
 public:
-    explicit RequestQueue(const SearchServer& search_server);
+    using Clock = std::chrono::steady_clock;
+
+    explicit RequestQueue(const SearchServer& search_server,
+                          Clock::duration history_duration = std::chrono::hours(24),
+                          Clock::duration bucket_duration = std::chrono::minutes(1));
     // сделаем "обертки" для всех методов поиска, чтобы сохранять результаты для нашей статистики
     template <typename DocumentPredicate>
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate);
     std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
     std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+    // Counts a request served elsewhere that has just finished
+    void RecordRequest(Clock::duration latency, size_t result_count);
+
+    // Requests with no results over the whole history
     int GetNoResultRequests() const;
+    RequestStats GetStats() const;
+    // Over the last window, rounded up to whole buckets, the current one included
+    RequestStats GetStats(Clock::duration window) const;
+
 private:
-    struct QueryResult {
-        uint64_t timestamp = 0;
-        int results = 0;
+    static constexpr size_t SHARD_COUNT = 16;
+
+    // Counts of the current bucket of a shard
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> bucket{0};
+        std::atomic<uint64_t> request_count{0};
+        std::atomic<uint64_t> no_result_count{0};
+        std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> latencies{};
+    };
+
+    struct Bucket {
+        // Number of bucket_duration_ periods since start_; NO_BUCKET while unused
+        uint64_t bucket = NO_BUCKET;
+        RequestStats stats;
     };
-    std::deque<QueryResult> requests_;
+    static constexpr uint64_t NO_BUCKET = UINT64_MAX;
+
     const SearchServer& search_server_;
-    int no_results_requests_;
-    uint64_t current_time_;
-    const static int min_in_day_ = 1440;
- 
-    void AddRequest(int results_num);
+    const Clock::time_point start_;
+    const Clock::duration bucket_duration_;
+    mutable std::array<Shard, SHARD_COUNT> shards_;
+    mutable std::mutex history_mutex_;
+    // Ring of past buckets, indexed by bucket number modulo its size
+    mutable std::vector<Bucket> history_;
+
+    uint64_t GetBucket(Clock::time_point time) const;
+    void Record(Clock::time_point finish, Clock::duration latency, size_t result_count);
+    // Moves the counts of the shard's bucket into the history if bucket is
+    // later; history_mutex_ must be held
+    void FlushShard(Shard& shard, uint64_t bucket) const;
 };
 
 template <typename DocumentPredicate>
 std::vector<Document> RequestQueue::AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+    const auto start = Clock::now();
     const auto result = search_server_.FindTopDocuments(raw_query, document_predicate);
-    AddRequest(result.size());
+    const auto finish = Clock::now();
+    Record(finish, finish - start, result.size());
     return result;
-}
\ No newline at end of file
+}
@@ -0,0 +1,26 @@
+#include "score_accumulator.h"
+
+using namespace std;
+
+ScoreAccumulator& ScoreAccumulator::ForCurrentThread() {
+    static thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
+
+void ScoreAccumulator::Reset(size_t ordinal_count) {
+    for (const int ordinal : scored_) {
+        scored_mask_[ordinal / 64] = 0;
+    }
+    scored_.clear();
+    for (const size_t word : dirty_excluded_words_) {
+        excluded_mask_[word] = 0;
+    }
+    dirty_excluded_words_.clear();
+
+    if (scores_.size() < ordinal_count) {
+        const size_t mask_size = (ordinal_count + 63) / 64;
+        scores_.resize(ordinal_count);
+        scored_mask_.resize(mask_size);
+        excluded_mask_.resize(mask_size);
+    }
+}
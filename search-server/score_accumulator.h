@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Relevance accumulator over dense document ordinals: a flat score array plus
+// bitmaps of scored and excluded ordinals. Reset clears only what the previous
+// query touched, so a reused accumulator does not allocate once it has grown
+// to the size of the index.
+class ScoreAccumulator {
+public:
+    // Accumulator of the calling thread, reused by every query run on it
+    static ScoreAccumulator& ForCurrentThread();
+
+    // Prepares the accumulator for ordinals in [0, ordinal_count)
+    void Reset(size_t ordinal_count);
+
+    void Add(int ordinal, double score) {
+        uint64_t& mask_word = scored_mask_[ordinal / 64];
+        const uint64_t bit = uint64_t{1} << (ordinal % 64);
+        if (mask_word & bit) {
+            scores_[ordinal] += score;
+        } else {
+            mask_word |= bit;
+            scores_[ordinal] = score;
+            scored_.push_back(ordinal);
+        }
+    }
+
+    // Excluded ordinals are skipped by ForEachScore whether scored before or after
+    void Exclude(int ordinal) {
+        uint64_t& mask_word = excluded_mask_[ordinal / 64];
+        if (mask_word == 0) {
+            dirty_excluded_words_.push_back(ordinal / 64);
+        }
+        mask_word |= uint64_t{1} << (ordinal % 64);
+    }
+
+    // Calls func(ordinal, score) for every scored and not excluded ordinal
+    template <typename Func>
+    void ForEachScore(Func func) const {
+        for (const int ordinal : scored_) {
+            if ((excluded_mask_[ordinal / 64] >> (ordinal % 64) & 1) == 0) {
+                func(ordinal, scores_[ordinal]);
+            }
+        }
+    }
+
+private:
+    std::vector<double> scores_;
+    std::vector<uint64_t> scored_mask_;
+    std::vector<uint64_t> excluded_mask_;
+    // Scored ordinals in the order they were first touched
+    std::vector<int> scored_;
+    std::vector<size_t> dirty_excluded_words_;
+};
@@ -0,0 +1,69 @@
+#include "search_cursor.h"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+// Parses the field up to the next dot, or the last field, and drops it from text
+template <typename Int>
+bool ParseField(string_view& text, Int& value, bool is_last) {
+    const size_t dot = text.find('.');
+    const string_view field = text.substr(0, dot);
+    if ((dot == string_view::npos) != is_last) {
+        return false;
+    }
+    const auto result = from_chars(field.data(), field.data() + field.size(), value, 16);
+    text.remove_prefix(is_last ? text.size() : dot + 1);
+    return !field.empty() && result.ec == errc() && result.ptr == field.data() + field.size();
+}
+
+template <typename Int>
+void AppendHex(string& text, Int value) {
+    char buffer[2 * sizeof(Int)];
+    const auto result = to_chars(begin(buffer), end(buffer), value, 16);
+    text.append(buffer, result.ptr);
+}
+
+}  // namespace
+
+SearchCursor SearchCursor::First() {
+    // Ranked above any finite relevance
+    return {numeric_limits<double>::infinity(), 0, 0};
+}
+
+SearchCursor SearchCursor::After(const Document& document) {
+    return {document.relevance, document.rating, document.id};
+}
+
+string SearchCursor::ToString() const {
+    // Relevance is kept as its bit pattern, so a cursor resumes exactly where
+    // the page ended
+    uint64_t relevance_bits = 0;
+    memcpy(&relevance_bits, &relevance, sizeof(relevance));
+    string text;
+    AppendHex(text, relevance_bits);
+    text.push_back('.');
+    AppendHex(text, static_cast<uint32_t>(rating));
+    text.push_back('.');
+    AppendHex(text, static_cast<uint32_t>(id));
+    return text;
+}
+
+SearchCursor SearchCursor::FromString(string_view text) {
+    uint64_t relevance_bits = 0;
+    uint32_t rating = 0;
+    uint32_t id = 0;
+    if (!ParseField(text, relevance_bits, false) || !ParseField(text, rating, false) || !ParseField(text, id, true)) {
+        throw invalid_argument("Invalid search cursor");
+    }
+    SearchCursor cursor;
+    memcpy(&cursor.relevance, &relevance_bits, sizeof(relevance_bits));
+    cursor.rating = static_cast<int>(rating);
+    cursor.id = static_cast<int>(id);
+    return cursor;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "document.h"
+#include <string>
+#include <string_view>
+
+// Position in ranking order right after a document of a results page, from
+// which SearchServer::FindTopDocumentsAfter continues. The text form is
+// opaque, to be handed to a client and back
+struct SearchCursor {
+    double relevance = 0.0;
+    int rating = 0;
+    int id = 0;
+
+    // Position before every result, where the first page starts
+    static SearchCursor First();
+    static SearchCursor After(const Document& document);
+
+    std::string ToString() const;
+    // Throws std::invalid_argument if the text was not made by ToString
+    static SearchCursor FromString(std::string_view text);
+};
@@ -1,148 +1,1130 @@
-#include "log_duration.h"
+#include "index_snapshot.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
 #include "search_server.h"
 #include "string_processing.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fcntl.h>
+#include <fstream>
 #include <iterator>
+#include <mutex>
 #include <numeric>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 using namespace std;
 
+// Makes the contents of a written file durable before it replaces another
+static void SyncFile(const string &path)
+{
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        throw runtime_error("Cannot open "s + path);
+    }
+    const bool is_synced = fsync(fd) == 0;
+    close(fd);
+    if (!is_synced)
+    {
+        throw runtime_error("Cannot write "s + path);
+    }
+}
+
 static int ComputeAverageRating(const vector<int> &ratings)
 {
     int rating_sum = accumulate(ratings.begin(), ratings.end(), 0);
     return rating_sum / static_cast<int>(ratings.size());
 }
 
+namespace
+{
+struct SliceTerm
+{
+    string_view word;
+    size_t term_id = 0;
+    vector<int> ordinals;
+    vector<double> term_freqs;
+};
+
+// Partial index of a contiguous range of a batch, built without touching the server
+struct SliceIndex
+{
+    vector<SliceTerm> terms;
+    // Words of every document of the slice: a term index and a position in its postings
+    vector<vector<pair<size_t, size_t>>> document_words;
+    // Text errors are thrown in batch order once all slices are built
+    vector<exception_ptr> errors;
+    // Filled while duplicate detection is on
+    vector<DocumentFingerprint> fingerprints;
+};
+}
+
 SearchServer::SearchServer(const std::string &stop_words_text)
     : SearchServer(SplitIntoWords(stop_words_text))
 {
 }
 
-SearchServer::SearchServer(const std::string_view stop_words_text)
-    : SearchServer(SplitIntoWords(stop_words_text))
+SearchServer::SearchServer(const std::string_view stop_words_text)
+    : SearchServer(SplitIntoWords(stop_words_text))
+{
+}
+
+void SearchServer::AddDocument(int document_id, const string &document, DocumentStatus status,
+                               const vector<int> &ratings)
+{
+    if ((document_id < 0) || (document_ordinals_.count(document_id) > 0))
+    {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    const auto words = SplitIntoWordsNoStop(document);
+    DocumentFingerprint fingerprint;
+    if (duplicate_detection_ != DuplicateDetection::OFF)
+    {
+        vector<string_view> distinct_words(words);
+        sort(distinct_words.begin(), distinct_words.end());
+        distinct_words.erase(unique(distinct_words.begin(), distinct_words.end()), distinct_words.end());
+        for (const string_view word : distinct_words)
+        {
+            fingerprint.AddWord(word);
+        }
+        CheckDuplicate(document_id, fingerprint);
+    }
+    const double inv_word_count = 1.0 / words.size();
+
+    const int ordinal = static_cast<int>(documents_.size());
+    documents_.Mutable().push_back(DocumentData{document_id, ComputeAverageRating(ratings), status});
+    document_ordinals_.emplace(document_id, ordinal);
+
+    vector<uint32_t> &word_term_ids = word_term_ids_.Mutable();
+    vector<double> &word_term_freqs = word_term_freqs_.Mutable();
+    const size_t first_word = word_term_ids.size();
+    for (const string_view word : words)
+    {
+        const size_t term_id = InternTerm(word);
+        postings_[term_id].Add(ordinal, inv_word_count);
+        DropImpacts(term_id);
+        word_term_ids.push_back(static_cast<uint32_t>(term_id));
+    }
+    // Repeated words are merged, summing frequencies the same way postings do
+    sort(word_term_ids.begin() + first_word, word_term_ids.end());
+    size_t last_word = first_word;
+    for (size_t i = first_word; i < word_term_ids.size(); ++last_word)
+    {
+        const uint32_t term_id = word_term_ids[i];
+        double term_freq = 0.0;
+        for (; i < word_term_ids.size() && word_term_ids[i] == term_id; ++i)
+        {
+            term_freq += inv_word_count;
+        }
+        word_term_ids[last_word] = term_id;
+        word_term_freqs.push_back(term_freq);
+    }
+    word_term_ids.resize(last_word);
+    word_offsets_.Mutable().push_back(last_word);
+    generation_ = NextGeneration();
+    document_ids_.insert(document_id);
+    if (duplicate_detection_ != DuplicateDetection::OFF)
+    {
+        AddFingerprint(document_id, fingerprint);
+    }
+    UpdateImpacts(1);
+}
+
+template <typename Policy>
+void SearchServer::IndexDocuments(const Policy &policy, const vector<NewDocument> &documents)
+{
+    const int first_ordinal = static_cast<int>(documents_.size());
+    size_t slice_count = 1;
+    if constexpr (is_same_v<Policy, execution::parallel_policy>)
+    {
+        slice_count = max<size_t>(1, min<size_t>(thread::hardware_concurrency() * 4, documents.size()));
+    }
+    const size_t slice_size = (documents.size() + slice_count - 1) / slice_count;
+    const auto get_slice_range = [&documents, slice_size](size_t slice)
+    {
+        const size_t first = min(documents.size(), slice * slice_size);
+        return pair{first, min(documents.size(), first + slice_size)};
+    };
+
+    vector<SliceIndex> slices(slice_count);
+    vector<size_t> slice_numbers(slice_count);
+    iota(slice_numbers.begin(), slice_numbers.end(), 0);
+    for_each(policy, slice_numbers.begin(), slice_numbers.end(), [&](size_t slice)
+             {
+        const auto [first, last] = get_slice_range(slice);
+        SliceIndex &index = slices[slice];
+        index.document_words.resize(last - first);
+        index.errors.resize(last - first);
+        if (duplicate_detection_ != DuplicateDetection::OFF)
+        {
+            index.fingerprints.resize(last - first);
+        }
+        unordered_map<string_view, size_t> term_indexes;
+        for (size_t i = first; i < last; ++i)
+        {
+            vector<string_view> words;
+            try
+            {
+                words = SplitIntoWordsNoStop(documents[i].text);
+            }
+            catch (...)
+            {
+                index.errors[i - first] = current_exception();
+                continue;
+            }
+            const double inv_word_count = 1.0 / words.size();
+            const int ordinal = first_ordinal + static_cast<int>(i);
+            for (const string_view word : words)
+            {
+                const auto [it, inserted] = term_indexes.emplace(word, index.terms.size());
+                if (inserted)
+                {
+                    index.terms.emplace_back().word = word;
+                }
+                SliceTerm &term = index.terms[it->second];
+                if (!term.ordinals.empty() && term.ordinals.back() == ordinal)
+                {
+                    term.term_freqs.back() += inv_word_count;
+                    continue;
+                }
+                index.document_words[i - first].emplace_back(it->second, term.ordinals.size());
+                term.ordinals.push_back(ordinal);
+                term.term_freqs.push_back(inv_word_count);
+            }
+            if (!index.fingerprints.empty())
+            {
+                for (const auto &[term_index, position] : index.document_words[i - first])
+                {
+                    index.fingerprints[i - first].AddWord(index.terms[term_index].word);
+                }
+            }
+        } });
+
+    unordered_set<int> batch_ids;
+    unordered_set<DocumentFingerprint, DocumentFingerprintHash> batch_fingerprints;
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+        const int document_id = documents[i].id;
+        if (document_id < 0 || document_ordinals_.count(document_id) > 0 || !batch_ids.insert(document_id).second)
+        {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        const SliceIndex &index = slices[i / slice_size];
+        if (const exception_ptr error = index.errors[i % slice_size])
+        {
+            rethrow_exception(error);
+        }
+        // A document also duplicates an earlier one of the batch
+        if (duplicate_detection_ == DuplicateDetection::REJECT)
+        {
+            const DocumentFingerprint &fingerprint = index.fingerprints[i % slice_size];
+            CheckDuplicate(document_id, fingerprint);
+            if (!batch_fingerprints.insert(fingerprint).second)
+            {
+                throw invalid_argument("Document "s + to_string(document_id) + " is a duplicate"s);
+            }
+        }
+    }
+
+    auto &documents_data = documents_.Mutable();
+    documents_data.reserve(documents_data.size() + documents.size());
+    for (size_t i = 0; i < documents.size(); ++i)
+    {
+        documents_data.push_back(DocumentData{documents[i].id, ComputeAverageRating(documents[i].ratings), documents[i].status});
+        document_ordinals_.emplace(documents[i].id, first_ordinal + static_cast<int>(i));
+        document_ids_.insert(documents[i].id);
+    }
+
+    // Each word is interned once per slice. Postings of slices are then appended
+    // in slice order, which is ordinal order, with different words in parallel
+    vector<pair<size_t, const SliceTerm *>> term_slices;
+    for (SliceIndex &index : slices)
+    {
+        for (SliceTerm &term : index.terms)
+        {
+            term.term_id = InternTerm(term.word);
+            term_slices.emplace_back(term.term_id, &term);
+        }
+    }
+    stable_sort(policy, term_slices.begin(), term_slices.end(), [](const auto &lhs, const auto &rhs)
+                { return lhs.first < rhs.first; });
+    vector<size_t> term_starts;
+    for (size_t i = 0; i < term_slices.size(); ++i)
+    {
+        if (i == 0 || term_slices[i].first != term_slices[i - 1].first)
+        {
+            term_starts.push_back(i);
+        }
+    }
+    for_each(policy, term_starts.begin(), term_starts.end(), [&](size_t start)
+             {
+        PostingList &postings = postings_[term_slices[start].first];
+        DropImpacts(term_slices[start].first);
+        for (size_t i = start; i < term_slices.size() && term_slices[i].first == term_slices[start].first; ++i)
+        {
+            const SliceTerm &term = *term_slices[i].second;
+            for (size_t j = 0; j < term.ordinals.size(); ++j)
+            {
+                postings.Add(term.ordinals[j], term.term_freqs[j]);
+            }
+        } });
+
+    vector<uint64_t> &word_offsets = word_offsets_.Mutable();
+    for (const SliceIndex &index : slices)
+    {
+        for (const auto &document_words : index.document_words)
+        {
+            word_offsets.push_back(word_offsets.back() + document_words.size());
+        }
+    }
+    vector<uint32_t> &word_term_ids = word_term_ids_.Mutable();
+    vector<double> &word_term_freqs = word_term_freqs_.Mutable();
+    word_term_ids.resize(word_offsets.back());
+    word_term_freqs.resize(word_offsets.back());
+    for_each(policy, slice_numbers.begin(), slice_numbers.end(), [&](size_t slice)
+             {
+        const auto [first, last] = get_slice_range(slice);
+        const SliceIndex &index = slices[slice];
+        for (size_t i = first; i < last; ++i)
+        {
+            uint64_t word = word_offsets[first_ordinal + i];
+            for (const auto &[term_index, position] : index.document_words[i - first])
+            {
+                const SliceTerm &term = index.terms[term_index];
+                word_term_ids[word] = static_cast<uint32_t>(term.term_id);
+                word_term_freqs[word] = term.term_freqs[position];
+                ++word;
+            }
+        } });
+    generation_ = NextGeneration();
+    if (duplicate_detection_ != DuplicateDetection::OFF)
+    {
+        for (size_t i = 0; i < documents.size(); ++i)
+        {
+            AddFingerprint(documents[i].id, slices[i / slice_size].fingerprints[i % slice_size]);
+        }
+    }
+    UpdateImpacts(documents.size());
+}
+
+void SearchServer::AddDocuments(const vector<NewDocument> &documents)
+{
+    IndexDocuments(execution::seq, documents);
+}
+
+void SearchServer::AddDocuments(execution::sequenced_policy policy, const vector<NewDocument> &documents)
+{
+    IndexDocuments(policy, documents);
+}
+
+void SearchServer::AddDocuments(execution::parallel_policy policy, const vector<NewDocument> &documents)
+{
+    IndexDocuments(policy, documents);
+}
+
+void SearchServer::AddDocumentsFrom(const SearchServer &other, const set<int> &skipped_ids)
+{
+    vector<int> ordinals;
+    for (const auto [id, ordinal] : other.document_ordinals_)
+    {
+        if (skipped_ids.count(id) == 0)
+        {
+            ordinals.push_back(ordinal);
+        }
+    }
+    // Documents keep the order they were added to the other index in
+    sort(ordinals.begin(), ordinals.end());
+
+    vector<DocumentFingerprint> fingerprints;
+    unordered_set<DocumentFingerprint, DocumentFingerprintHash> batch_fingerprints;
+    for (const int ordinal : ordinals)
+    {
+        const int document_id = other.documents_[ordinal].id;
+        if (document_ordinals_.count(document_id) > 0)
+        {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        if (duplicate_detection_ != DuplicateDetection::OFF)
+        {
+            fingerprints.push_back(other.ComputeFingerprint(ordinal));
+            if (duplicate_detection_ == DuplicateDetection::REJECT)
+            {
+                CheckDuplicate(document_id, fingerprints.back());
+                if (!batch_fingerprints.insert(fingerprints.back()).second)
+                {
+                    throw invalid_argument("Document "s + to_string(document_id) + " is a duplicate"s);
+                }
+            }
+        }
+    }
+
+    // Term ids in this index of the other index's terms, interned on first use
+    vector<uint32_t> term_ids(other.terms_.size(), UINT32_MAX);
+    vector<pair<uint32_t, double>> words;
+    auto &documents_data = documents_.Mutable();
+    vector<uint64_t> &word_offsets = word_offsets_.Mutable();
+    vector<uint32_t> &word_term_ids = word_term_ids_.Mutable();
+    vector<double> &word_term_freqs = word_term_freqs_.Mutable();
+    documents_data.reserve(documents_data.size() + ordinals.size());
+    word_offsets.reserve(word_offsets.size() + ordinals.size());
+    for (size_t i = 0; i < ordinals.size(); ++i)
+    {
+        const int other_ordinal = ordinals[i];
+        const int ordinal = static_cast<int>(documents_data.size());
+        const DocumentData &document_data = other.documents_[other_ordinal];
+        documents_data.push_back(document_data);
+        document_ordinals_.emplace(document_data.id, ordinal);
+        document_ids_.insert(document_data.id);
+
+        words.clear();
+        for (uint64_t j = other.word_offsets_[other_ordinal]; j < other.word_offsets_[other_ordinal + 1]; ++j)
+        {
+            uint32_t &term_id = term_ids[other.word_term_ids_[j]];
+            if (term_id == UINT32_MAX)
+            {
+                term_id = static_cast<uint32_t>(InternTerm(other.terms_[other.word_term_ids_[j]]));
+            }
+            words.emplace_back(term_id, other.word_term_freqs_[j]);
+        }
+        // Words of a document are kept sorted by term id, as AddDocument does
+        sort(words.begin(), words.end());
+        for (const auto &[term_id, term_freq] : words)
+        {
+            postings_[term_id].Add(ordinal, term_freq);
+            DropImpacts(term_id);
+            word_term_ids.push_back(term_id);
+            word_term_freqs.push_back(term_freq);
+        }
+        word_offsets.push_back(word_term_ids.size());
+        if (duplicate_detection_ != DuplicateDetection::OFF)
+        {
+            AddFingerprint(document_data.id, fingerprints[i]);
+        }
+    }
+    generation_ = NextGeneration();
+    UpdateImpacts(ordinals.size());
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status,
+                                                size_t max_count) const
+{
+    return FindTopDocuments(execution::seq, raw_query, status, max_count);
+}
+
+vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+vector<Document> SearchServer::FindTopDocumentsPage(const string_view raw_query, DocumentStatus status,
+                                                    size_t offset, size_t limit) const
+{
+    return FindTopDocumentsPage(raw_query, [status](int, DocumentStatus document_status, int)
+                                { return document_status == status; },
+                                offset, limit);
+}
+
+vector<Document> SearchServer::FindTopDocumentsPage(const string_view raw_query, size_t offset, size_t limit) const
+{
+    return FindTopDocumentsPage(raw_query, DocumentStatus::ACTUAL, offset, limit);
+}
+
+vector<Document> SearchServer::FindTopDocumentsAfter(const string_view raw_query, DocumentStatus status,
+                                                     const SearchCursor &after, size_t limit) const
+{
+    return FindTopDocumentsAfter(raw_query, [status](int, DocumentStatus document_status, int)
+                                 { return document_status == status; },
+                                 after, limit);
+}
+
+vector<Document> SearchServer::FindTopDocumentsAfter(const string_view raw_query, const SearchCursor &after,
+                                                     size_t limit) const
+{
+    return FindTopDocumentsAfter(raw_query, DocumentStatus::ACTUAL, after, limit);
+}
+
+template <typename Policy>
+vector<vector<Document>> SearchServer::SearchBatch(const Policy &policy, const vector<string> &raw_queries) const
+{
+    vector<size_t> query_indexes(raw_queries.size());
+    iota(query_indexes.begin(), query_indexes.end(), 0);
+    vector<Query> queries(raw_queries.size());
+    vector<exception_ptr> errors(raw_queries.size());
+    for_each(policy, query_indexes.begin(), query_indexes.end(), [&](size_t i)
+             {
+                 try
+                 {
+                     queries[i] = ParseQuery(raw_queries[i], pmr::get_default_resource());
+                 }
+                 catch (...)
+                 {
+                     errors[i] = current_exception();
+                 } });
+    for (const exception_ptr &error : errors)
+    {
+        if (error)
+        {
+            rethrow_exception(error);
+        }
+    }
+
+    // Every distinct word of the batch is resolved once; queries refer to words by index
+    unordered_map<string_view, size_t> word_indexes;
+    vector<pair<const PostingList *, double>> words;
+    vector<vector<size_t>> plus_words(queries.size());
+    vector<vector<size_t>> minus_words(queries.size());
+    const auto add_word = [&](string_view word)
+    {
+        const auto [it, inserted] = word_indexes.emplace(word, words.size());
+        if (inserted)
+        {
+            const PostingList *postings = FindPostings(word);
+            const bool has_postings = postings != nullptr && GetLiveDocumentFreq(*postings) > 0;
+            words.emplace_back(postings, has_postings ? ComputeWordInverseDocumentFreq(word, *postings) : 0.0);
+        }
+        return it->second;
+    };
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        for (const string_view word : queries[i].plus_words)
+        {
+            plus_words[i].push_back(add_word(word));
+        }
+        for (const string_view word : queries[i].minus_words)
+        {
+            minus_words[i].push_back(add_word(word));
+        }
+    }
+
+    vector<vector<Document>> results(queries.size());
+    const auto status_predicate = [](int, DocumentStatus document_status, int)
+    { return document_status == DocumentStatus::ACTUAL; };
+    for_each(policy, query_indexes.begin(), query_indexes.end(), [&](size_t i)
+             {
+        string key;
+        if (query_cache_ != nullptr)
+        {
+            key = MakeQueryCacheKey(queries[i], DocumentStatus::ACTUAL, MAX_RESULT_DOCUMENT_COUNT);
+            if (auto documents = query_cache_->Find(key, generation_))
+            {
+                results[i] = move(*documents);
+                return;
+            }
+        }
+
+        QueryArena &arena = QueryArena::ForCurrentThread();
+        QueryArena::Scope scope(arena);
+        ResolvedQuery query(&arena);
+        for (const size_t word : plus_words[i])
+        {
+            const auto [postings, inverse_document_freq] = words[word];
+            if (postings != nullptr && GetLiveDocumentFreq(*postings) > 0)
+            {
+                query.plus_postings.emplace_back(postings, inverse_document_freq);
+            }
+        }
+        for (const size_t word : minus_words[i])
+        {
+            if (words[word].first != nullptr)
+            {
+                query.minus_postings.push_back(words[word].first);
+            }
+        }
+        results[i] = RankDocuments(execution::seq, query, status_predicate, TopDocuments(MAX_RESULT_DOCUMENT_COUNT));
+        if (query_cache_ != nullptr)
+        {
+            query_cache_->Insert(key, generation_, results[i]);
+        } });
+    return results;
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(const vector<string> &raw_queries) const
+{
+    return SearchBatch(execution::seq, raw_queries);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(execution::sequenced_policy policy,
+                                                             const vector<string> &raw_queries) const
+{
+    return SearchBatch(policy, raw_queries);
+}
+
+vector<vector<Document>> SearchServer::FindTopDocumentsBatch(execution::parallel_policy policy,
+                                                             const vector<string> &raw_queries) const
+{
+    return SearchBatch(policy, raw_queries);
+}
+
+void SearchServer::SetIndexStorage(IndexStorage index_storage)
+{
+    index_storage_ = index_storage;
+    for (PostingList &postings : postings_)
+    {
+        postings.SetCompressed(index_storage_ == IndexStorage::COMPRESSED);
+    }
+    // Compression changes relevance slightly
+    generation_ = NextGeneration();
+    if (impact_scoring_ != ImpactScoring::OFF)
+    {
+        RefreshImpacts();
+    }
+}
+
+IndexStorage SearchServer::GetIndexStorage() const
+{
+    return index_storage_;
+}
+
+void SearchServer::SetDuplicateDetection(DuplicateDetection duplicate_detection)
+{
+    if (duplicate_detection == DuplicateDetection::OFF)
+    {
+        fingerprint_counts_.clear();
+        flagged_duplicates_.clear();
+    }
+    else if (duplicate_detection_ == DuplicateDetection::OFF)
+    {
+        for (const auto &[document_id, ordinal] : document_ordinals_)
+        {
+            ++fingerprint_counts_[ComputeFingerprint(ordinal)];
+        }
+    }
+    duplicate_detection_ = duplicate_detection;
+}
+
+DuplicateDetection SearchServer::GetDuplicateDetection() const
+{
+    return duplicate_detection_;
+}
+
+const set<int> &SearchServer::GetFlaggedDuplicates() const
+{
+    return flagged_duplicates_;
+}
+
+DocumentFingerprint SearchServer::GetDocumentFingerprint(int document_id) const
+{
+    return ComputeFingerprint(document_ordinals_.at(document_id));
+}
+
+DocumentFingerprint SearchServer::ComputeFingerprint(int ordinal) const
+{
+    // The forward index holds every word of a document once
+    DocumentFingerprint fingerprint;
+    for (uint64_t i = word_offsets_[ordinal]; i < word_offsets_[ordinal + 1]; ++i)
+    {
+        fingerprint.AddWord(terms_[word_term_ids_[i]]);
+    }
+    return fingerprint;
+}
+
+void SearchServer::CheckDuplicate(int document_id, const DocumentFingerprint &fingerprint) const
+{
+    if (duplicate_detection_ == DuplicateDetection::REJECT && fingerprint_counts_.count(fingerprint) > 0)
+    {
+        throw invalid_argument("Document "s + to_string(document_id) + " is a duplicate"s);
+    }
+}
+
+void SearchServer::AddFingerprint(int document_id, const DocumentFingerprint &fingerprint)
+{
+    if (fingerprint_counts_[fingerprint]++ > 0 && duplicate_detection_ == DuplicateDetection::FLAG)
+    {
+        flagged_duplicates_.insert(document_id);
+    }
+}
+
+void SearchServer::RemoveFingerprint(int document_id, int ordinal)
+{
+    const auto it = fingerprint_counts_.find(ComputeFingerprint(ordinal));
+    if (--it->second == 0)
+    {
+        fingerprint_counts_.erase(it);
+    }
+    flagged_duplicates_.erase(document_id);
+}
+
+void SearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation)
+{
+    query_evaluation_ = query_evaluation;
+}
+
+QueryEvaluation SearchServer::GetQueryEvaluation() const
+{
+    return query_evaluation_;
+}
+
+void SearchServer::SetImpactScoring(ImpactScoring impact_scoring)
+{
+    impact_scoring_ = impact_scoring;
+    RefreshImpacts();
+}
+
+ImpactScoring SearchServer::GetImpactScoring() const
+{
+    return impact_scoring_;
+}
+
+void SearchServer::SetImpactRefreshTolerance(double tolerance)
+{
+    impact_refresh_tolerance_ = tolerance;
+    UpdateImpacts(0);
+}
+
+double SearchServer::GetImpactRefreshTolerance() const
+{
+    return impact_refresh_tolerance_;
+}
+
+void SearchServer::RefreshImpacts()
+{
+    // Dropped first, so inverse document frequencies are computed afresh
+    impacts_.clear();
+    impact_changed_document_count_ = 0;
+    impact_document_count_ = term_statistics_ != nullptr ? term_statistics_->GetDocumentCount() : GetDocumentCount();
+    generation_ = NextGeneration();
+    if (impact_scoring_ == ImpactScoring::OFF)
+    {
+        impacts_.shrink_to_fit();
+        return;
+    }
+
+    // Term statistics are read on this thread only, the lists are built in parallel
+    vector<double> inverse_document_freqs(postings_.size(), 0.0);
+    vector<uint32_t> term_ids;
+    for (size_t term_id = 0; term_id < postings_.size(); ++term_id)
+    {
+        if (GetLiveDocumentFreq(postings_[term_id]) > 0)
+        {
+            inverse_document_freqs[term_id] = ComputeWordInverseDocumentFreq(terms_[term_id], postings_[term_id]);
+            term_ids.push_back(static_cast<uint32_t>(term_id));
+        }
+    }
+    vector<shared_ptr<const ImpactList>> impacts(postings_.size());
+    for_each(execution::par, term_ids.begin(), term_ids.end(), [&](uint32_t term_id)
+             {
+        vector<int> ordinals;
+        vector<double> term_freqs;
+        // Documents marked removed are left out, so the list outlives CompactIndex
+        postings_[term_id].ForEachPosting([&](int ordinal, double term_freq)
+                                          {
+                                              if (!IsRemoved(ordinal))
+                                              {
+                                                  ordinals.push_back(ordinal);
+                                                  term_freqs.push_back(term_freq);
+                                              } });
+        impacts[term_id] = make_shared<const ImpactList>(move(ordinals), term_freqs, inverse_document_freqs[term_id],
+                                                         impact_scoring_ == ImpactScoring::QUANTIZED); });
+    impacts_ = move(impacts);
+}
+
+void SearchServer::UpdateImpacts(size_t changed_document_count)
+{
+    if (impact_scoring_ == ImpactScoring::OFF)
+    {
+        return;
+    }
+    impact_changed_document_count_ += changed_document_count;
+    const int document_count = term_statistics_ != nullptr ? term_statistics_->GetDocumentCount() : GetDocumentCount();
+    const double drift = max<double>(impact_changed_document_count_, abs(document_count - impact_document_count_));
+    if (drift > impact_refresh_tolerance_ * impact_document_count_)
+    {
+        RefreshImpacts();
+    }
+}
+
+void SearchServer::SetQueryCacheCapacity(size_t capacity)
+{
+    query_cache_ = capacity == 0 ? nullptr : make_shared<QueryResultCache>(capacity);
+}
+
+size_t SearchServer::GetQueryCacheCapacity() const
+{
+    return query_cache_ == nullptr ? 0 : query_cache_->GetCapacity();
+}
+
+QueryCacheStats SearchServer::GetQueryCacheStats() const
+{
+    return query_cache_ == nullptr ? QueryCacheStats{} : query_cache_->GetStats();
+}
+
+void SearchServer::SetTermStatistics(const TermStatistics *statistics)
+{
+    term_statistics_ = statistics;
+    generation_ = NextGeneration();
+    if (impact_scoring_ != ImpactScoring::OFF)
+    {
+        RefreshImpacts();
+    }
+}
+
+const TermStatistics *SearchServer::GetTermStatistics() const
+{
+    return term_statistics_;
+}
+
+int SearchServer::GetDocumentCount() const
+{
+    return document_ordinals_.size();
+}
+
+size_t SearchServer::GetDocumentFreq(const string_view word) const
+{
+    const PostingList *postings = FindPostings(word);
+    return postings == nullptr ? 0 : GetLiveDocumentFreq(*postings);
+}
+
+set<int>::iterator SearchServer::begin()
+{
+    return document_ids_.begin();
+}
+
+set<int>::iterator SearchServer::end()
+{
+    return document_ids_.end();
+}
+
+set<int>::const_iterator SearchServer::begin() const
+{
+    return document_ids_.begin();
+}
+
+set<int>::const_iterator SearchServer::end() const
+{
+    return document_ids_.end();
+}
+
+const map<string_view, double, std::less<>> &SearchServer::GetWordFrequencies(int document_id) const
+{
+    static const map<string_view, double, std::less<>> empty_map{};
+    if (document_id < 0)
+    {
+        throw invalid_argument("Invalid document_id"s);
+    }
+    const auto ordinal_it = document_ordinals_.find(document_id);
+    if (ordinal_it == document_ordinals_.end())
+    {
+        return empty_map;
+    }
+
+    const int ordinal = ordinal_it->second;
+    lock_guard lock(word_freqs_cache_.mutex);
+    auto [it, inserted] = word_freqs_cache_.ordinal_to_word_freqs.try_emplace(ordinal);
+    if (inserted)
+    {
+        for (uint64_t i = word_offsets_[ordinal]; i < word_offsets_[ordinal + 1]; ++i)
+        {
+            it->second.emplace(terms_[word_term_ids_[i]], word_term_freqs_[i]);
+        }
+    }
+    return it->second;
+}
+
+void SearchServer::RemoveDocument(int document_id)
+{
+    const int ordinal = document_ordinals_.at(document_id);
+    if (deletion_mode_ == DeletionMode::TOMBSTONE)
+    {
+        MarkRemoved(ordinal);
+    }
+    else
+    {
+        for (uint64_t i = word_offsets_[ordinal]; i < word_offsets_[ordinal + 1]; ++i)
+        {
+            postings_[word_term_ids_[i]].Remove(ordinal);
+        }
+    }
+    EraseDocument(document_id, ordinal);
+    UpdateImpacts(1);
+}
+
+void SearchServer::EraseDocument(int document_id, int ordinal)
+{
+    {
+        lock_guard lock(word_freqs_cache_.mutex);
+        word_freqs_cache_.ordinal_to_word_freqs.erase(ordinal);
+    }
+    if (duplicate_detection_ != DuplicateDetection::OFF)
+    {
+        RemoveFingerprint(document_id, ordinal);
+    }
+    // The document frequencies of its words change, whatever the deletion mode
+    for (uint64_t i = word_offsets_[ordinal]; i < word_offsets_[ordinal + 1]; ++i)
+    {
+        DropImpacts(word_term_ids_[i]);
+    }
+    removed_word_count_ += word_offsets_[ordinal + 1] - word_offsets_[ordinal];
+    document_ordinals_.erase(document_id);
+    document_ids_.erase(document_id);
+    generation_ = NextGeneration();
+}
+
+void SearchServer::MarkRemoved(int ordinal)
+{
+    const size_t word = static_cast<size_t>(ordinal) / 64;
+    if (word >= removed_ordinals_.size())
+    {
+        removed_ordinals_.resize(max(word + 1, (documents_.size() + 63) / 64));
+    }
+    removed_ordinals_[word] |= uint64_t{1} << (ordinal % 64);
+    if (removed_posting_counts_.size() < postings_.size())
+    {
+        removed_posting_counts_.resize(postings_.size());
+    }
+    for (uint64_t i = word_offsets_[ordinal]; i < word_offsets_[ordinal + 1]; ++i)
+    {
+        ++removed_posting_counts_[word_term_ids_[i]];
+    }
+}
+
+size_t SearchServer::GetLiveDocumentFreq(const PostingList &postings) const
+{
+    const size_t term_id = &postings - postings_.data();
+    return postings.size() - (term_id < removed_posting_counts_.size() ? removed_posting_counts_[term_id] : 0);
+}
+
+template <typename Policy>
+void SearchServer::PurgeRemovedPostings(const Policy &policy)
 {
+    vector<uint32_t> term_ids;
+    for (size_t term_id = 0; term_id < removed_posting_counts_.size(); ++term_id)
+    {
+        if (removed_posting_counts_[term_id] > 0)
+        {
+            term_ids.push_back(static_cast<uint32_t>(term_id));
+        }
+    }
+    // Distinct words own distinct posting lists, so they can be rewritten concurrently
+    for_each(policy, term_ids.begin(), term_ids.end(), [this](uint32_t term_id)
+             { postings_[term_id].RemoveIf([this](int ordinal)
+                                           { return IsRemoved(ordinal); }); });
+    removed_ordinals_.clear();
+    removed_posting_counts_.clear();
 }
 
-void SearchServer::AddDocument(int document_id, const string &document, DocumentStatus status,
-                               const vector<int> &ratings)
+template <typename Policy>
+void SearchServer::RemoveBatch(const Policy &policy, const vector<int> &document_ids)
 {
-    if ((document_id < 0) || (documents_.count(document_id) > 0))
+    // Every id is checked before anything is removed
+    vector<int> ordinals;
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids)
     {
-        throw invalid_argument("Invalid document_id"s);
+        ordinals.push_back(document_ordinals_.at(document_id));
     }
-    const auto words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
-
-    vector<string> data;
-    for (const string_view word : words)
+    vector<int> sorted_ordinals = ordinals;
+    sort(sorted_ordinals.begin(), sorted_ordinals.end());
+    if (const auto it = adjacent_find(sorted_ordinals.begin(), sorted_ordinals.end()); it != sorted_ordinals.end())
     {
-        data.emplace_back(string(word));
+        throw out_of_range("Document "s + to_string(documents_[*it].id) + " is listed twice"s);
     }
 
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status, move(data)});
-
-    for (const string_view word : documents_[document_id].data)
+    for (size_t i = 0; i < document_ids.size(); ++i)
     {
-        word_to_document_freqs_[word][document_id] += inv_word_count;
-        document_to_word_freqs_[document_id][word] += inv_word_count;
+        MarkRemoved(ordinals[i]);
+        EraseDocument(document_ids[i], ordinals[i]);
     }
-    document_ids_.insert(document_id);
+    if (deletion_mode_ == DeletionMode::IMMEDIATE)
+    {
+        PurgeRemovedPostings(policy);
+    }
+    UpdateImpacts(document_ids.size());
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status) const
+void SearchServer::RemoveDocuments(const vector<int> &document_ids)
 {
-    return FindTopDocuments(execution::seq,
-                            raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-                            { return document_status == status; });
+    RemoveBatch(execution::seq, document_ids);
 }
 
-vector<Document> SearchServer::FindTopDocuments(const string_view raw_query) const
+void SearchServer::RemoveDocuments(execution::sequenced_policy policy, const vector<int> &document_ids)
 {
-    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+    RemoveBatch(policy, document_ids);
 }
 
-int SearchServer::GetDocumentCount() const
+void SearchServer::RemoveDocuments(execution::parallel_policy policy, const vector<int> &document_ids)
 {
-    return documents_.size();
+    RemoveBatch(policy, document_ids);
 }
 
-set<int>::iterator SearchServer::begin()
+void SearchServer::SetDeletionMode(DeletionMode deletion_mode)
 {
-    return document_ids_.begin();
+    deletion_mode_ = deletion_mode;
+    if (deletion_mode_ == DeletionMode::IMMEDIATE)
+    {
+        PurgeRemovedPostings(execution::seq);
+    }
 }
 
-set<int>::iterator SearchServer::end()
+DeletionMode SearchServer::GetDeletionMode() const
 {
-    return document_ids_.end();
+    return deletion_mode_;
 }
 
-const map<string_view, double, std::less<>> &SearchServer::GetWordFrequencies(int document_id) const
+template <typename Policy>
+void SearchServer::Compact(const Policy &policy)
 {
-    static const map<string_view, double, std::less<>> empty_map{};
-    if (document_id < 0)
+    PurgeRemovedPostings(policy);
+
+    vector<bool> keep(postings_.size());
+    vector<uint32_t> new_term_ids(postings_.size());
+    vector<PostingList> postings;
+    for (size_t term_id = 0; term_id < postings_.size(); ++term_id)
     {
-        throw invalid_argument("Invalid document_id"s);
+        keep[term_id] = !postings_[term_id].empty();
+        if (keep[term_id])
+        {
+            new_term_ids[term_id] = static_cast<uint32_t>(postings.size());
+            postings.push_back(move(postings_[term_id]));
+        }
     }
-    if (document_to_word_freqs_.count(document_id) == 0)
+    terms_.Retain(keep);
+    postings_ = move(postings);
+    // Impacts leave out documents marked removed, so they only need renumbering
+    for (size_t term_id = 0; term_id < impacts_.size(); ++term_id)
     {
-        return empty_map;
+        if (keep[term_id])
+        {
+            impacts_[new_term_ids[term_id]] = move(impacts_[term_id]);
+        }
     }
-    return document_to_word_freqs_.at(document_id);
-}
+    impacts_.resize(min(impacts_.size(), postings_.size()));
 
-void SearchServer::RemoveDocument(int document_id)
-{
-    for (const auto &[word, value] : document_to_word_freqs_.at(document_id))
+    // Live documents are numbered anew in the same order, so ordinals of
+    // removed documents stop taking room in documents_ and query scratch
+    vector<int> new_ordinals(documents_.size(), -1);
+    for (const auto [id, ordinal] : document_ordinals_)
+    {
+        new_ordinals[ordinal] = 0;
+    }
+    int live_count = 0;
+    int first_moved = static_cast<int>(documents_.size());
+    for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal)
     {
-        word_to_document_freqs_.find(word)->second.erase(document_id);
+        if (new_ordinals[ordinal] < 0)
+        {
+            first_moved = min(first_moved, static_cast<int>(ordinal));
+            continue;
+        }
+        new_ordinals[ordinal] = live_count++;
     }
 
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+    vector<DocumentData> documents;
+    documents.reserve(live_count);
+    vector<uint64_t> word_offsets{0};
+    word_offsets.reserve(live_count + 1);
+    vector<uint32_t> word_term_ids;
+    vector<double> word_term_freqs;
+    word_term_ids.reserve(word_term_ids_.size() - removed_word_count_);
+    word_term_freqs.reserve(word_term_ids_.size() - removed_word_count_);
+    for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal)
+    {
+        if (new_ordinals[ordinal] < 0)
+        {
+            continue;
+        }
+        documents.push_back(documents_[ordinal]);
+        for (uint64_t i = word_offsets_[ordinal]; i < word_offsets_[ordinal + 1]; ++i)
+        {
+            word_term_ids.push_back(new_term_ids[word_term_ids_[i]]);
+            word_term_freqs.push_back(word_term_freqs_[i]);
+        }
+        word_offsets.push_back(word_term_ids.size());
+    }
+    if (first_moved < static_cast<int>(documents_.size()))
+    {
+        // Lists whose postings all precede the first removed ordinal keep their numbers
+        for_each(policy, postings_.begin(), postings_.end(), [&](PostingList &postings)
+                 {
+            if (postings.GetLastOrdinal() >= first_moved)
+            {
+                postings.Renumber(new_ordinals);
+            } });
+        for (auto &impacts : impacts_)
+        {
+            if (impacts)
+            {
+                impacts = make_shared<const ImpactList>(impacts->Renumbered(new_ordinals));
+            }
+        }
+        for (auto &[id, ordinal] : document_ordinals_)
+        {
+            ordinal = new_ordinals[ordinal];
+        }
+        lock_guard lock(word_freqs_cache_.mutex);
+        word_freqs_cache_.ordinal_to_word_freqs.clear();
+    }
+    documents_ = ArrayStorage<DocumentData>(move(documents));
+    word_offsets_ = ArrayStorage<uint64_t>(move(word_offsets));
+    word_term_ids_ = ArrayStorage<uint32_t>(move(word_term_ids));
+    word_term_freqs_ = ArrayStorage<double>(move(word_term_freqs));
+    removed_word_count_ = 0;
+    // Rewritten compressed lists quantize their blocks anew
+    generation_ = NextGeneration();
+}
+
+void SearchServer::CompactIndex()
+{
+    Compact(execution::seq);
+}
+
+void SearchServer::CompactIndex(execution::sequenced_policy policy)
+{
+    Compact(policy);
+}
+
+void SearchServer::CompactIndex(execution::parallel_policy policy)
+{
+    Compact(policy);
+}
+
+size_t SearchServer::GetRemovedWordCount() const
+{
+    return removed_word_count_;
 }
 
 tuple<vector<string_view>, DocumentStatus> SearchServer::MatchDocument(const string_view raw_query,
                                                                        int document_id) const
 {
-    // LOG_DURATION_STREAM("Operation time", cout);
-
     if (document_id < 0)
     {
         throw(invalid_argument("ID cannot be less than 0"));
     }
 
-    const auto query = ParseQuery(raw_query);
-
-    vector<string_view> matched_words;
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    const auto query = ParseQuery(raw_query, &arena);
+    const int ordinal = document_ordinals_.at(document_id);
+    const auto &document_data = documents_[ordinal];
 
     for (const string_view word : query.minus_words)
     {
-        if (word_to_document_freqs_.count(word) == 0)
-        {
-            continue;
-        }
-        if (word_to_document_freqs_.find(word)->second.count(document_id))
+        const PostingList *postings = FindPostings(word);
+        if (postings != nullptr && postings->Contains(ordinal))
         {
-            return {matched_words, documents_.at(document_id).status};
+            return {vector<string_view>(), document_data.status};
         }
     }
+    // Collected in the arena, so the result is allocated once at its final size
+    pmr::vector<string_view> matched_words(&arena);
+    matched_words.reserve(query.plus_words.size());
     for (const string_view word : query.plus_words)
     {
-        if (word_to_document_freqs_.count(word) == 0)
-        {
-            continue;
-        }
-        if (word_to_document_freqs_.find(word)->second.count(document_id))
+        const size_t term_id = terms_.Find(word);
+        if (term_id != terms_.size() && postings_[term_id].Contains(ordinal))
         {
-            matched_words.push_back(word_to_document_freqs_.find(word)->first);
+            matched_words.push_back(terms_[term_id]);
         }
     }
-    return {matched_words, documents_.at(document_id).status};
+    return {vector<string_view>(matched_words.begin(), matched_words.end()), document_data.status};
 }
 
 bool SearchServer::IsStopWord(const std::string_view word) const
@@ -150,6 +1132,22 @@ bool SearchServer::IsStopWord(const std::string_view word) const
     return stop_words_.count(word) > 0;
 }
 
+size_t SearchServer::InternTerm(const std::string_view word)
+{
+    const size_t term_id = terms_.Intern(word);
+    if (term_id == postings_.size())
+    {
+        postings_.emplace_back(index_storage_ == IndexStorage::COMPRESSED);
+    }
+    return term_id;
+}
+
+const PostingList *SearchServer::FindPostings(const std::string_view word) const
+{
+    const size_t term_id = terms_.Find(word);
+    return term_id == terms_.size() ? nullptr : &postings_[term_id];
+}
+
 bool SearchServer::IsValidWord(const std::string_view word)
 {
     // A valid word must not contain special characters
@@ -160,21 +1158,18 @@ bool SearchServer::IsValidWord(const std::string_view word)
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(std::string_view text) const
 {
     std::vector<string_view> words;
-    for (const string_view word : SplitIntoWords(text))
+    const size_t invalid_word = SplitIntoWords(text, words);
+    if (invalid_word != words.size())
     {
-        if (!IsValidWord(word))
-        {
-            throw invalid_argument("Word "s + std::string(word) + " is invalid"s);
-        }
-        if (!IsStopWord(word))
-        {
-            words.push_back(word);
-        }
+        throw invalid_argument("Word "s + std::string(words[invalid_word]) + " is invalid"s);
     }
+    words.erase(remove_if(words.begin(), words.end(), [this](string_view word)
+                          { return IsStopWord(word); }),
+                words.end());
     return words;
 }
 
-SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text) const
+SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text, bool is_valid) const
 {
     if (text.empty())
     {
@@ -187,59 +1182,178 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(const std::string_view text
         is_minus = true;
         word = word.substr(1);
     }
-    if (word.empty() || word[0] == '-' || !IsValidWord(word))
+    if (word.empty() || word[0] == '-' || !is_valid)
     {
         throw std::invalid_argument("Query word "s + std::string(text) + " is invalid");
     }
     return {word, is_minus, IsStopWord(word)};
 }
 
-SearchServer::Query SearchServer::ParseQuery(const std::string_view text) const
+SearchServer::Query SearchServer::ParseQuery(const std::string_view text, std::pmr::memory_resource *resource) const
 {
-    Query result;
-    for (const std::string_view word : SplitIntoWords(text))
+    INSTRUMENT_STAGE(QueryStage::PARSE);
+    Query result(resource);
+    std::pmr::vector<std::string_view> words(resource);
+    const size_t invalid_word = SplitIntoWords(text, words);
+    result.plus_words.reserve(words.size());
+    result.minus_words.reserve(words.size());
+    for (size_t i = 0; i < words.size(); ++i)
     {
-        const auto query_word = ParseQueryWord(word);
+        // Parsing stops at the first invalid word, so later words are never checked
+        const auto query_word = ParseQueryWord(words[i], i < invalid_word);
         if (!query_word.is_stop)
         {
             if (query_word.is_minus)
             {
-                result.minus_words.insert(query_word.data);
+                result.minus_words.push_back(query_word.data);
             }
             else
             {
-                result.plus_words.insert(query_word.data);
+                result.plus_words.push_back(query_word.data);
             }
         }
     }
+    for (auto *query_words : {&result.plus_words, &result.minus_words})
+    {
+        sort(query_words->begin(), query_words->end());
+        query_words->erase(unique(query_words->begin(), query_words->end()), query_words->end());
+    }
     return result;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view word) const
+SearchServer::ResolvedQuery SearchServer::ResolveQuery(const Query &query) const
 {
-    return log(GetDocumentCount() * 1.0 / word_to_document_freqs_.find(word)->second.size());
+    INSTRUMENT_STAGE(QueryStage::RESOLVE);
+    ResolvedQuery resolved(query.plus_words.get_allocator().resource());
+    resolved.plus_postings.reserve(query.plus_words.size());
+    resolved.minus_postings.reserve(query.minus_words.size());
+    for (const string_view word : query.plus_words)
+    {
+        const PostingList *postings = FindPostings(word);
+        if (postings != nullptr && GetLiveDocumentFreq(*postings) > 0)
+        {
+            resolved.plus_postings.emplace_back(postings, ComputeWordInverseDocumentFreq(word, *postings));
+        }
+    }
+    for (const string_view word : query.minus_words)
+    {
+        if (const PostingList *postings = FindPostings(word))
+        {
+            resolved.minus_postings.push_back(postings);
+        }
+    }
+    return resolved;
 }
 
-void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int document_id)
+SearchCursor SearchServer::AnchorCursor(const ResolvedQuery &query, const SearchCursor &after, bool is_wand) const
+{
+    // SearchCursor::First() stands before every document, not after one
+    if (isinf(after.relevance))
+    {
+        return after;
+    }
+    const auto it = document_ordinals_.find(after.id);
+    if (it == document_ordinals_.end() || IsRemoved(it->second))
+    {
+        return after;
+    }
+    const int ordinal = it->second;
+    for (const PostingList *postings : query.minus_postings)
+    {
+        if (postings->Contains(ordinal))
+        {
+            return after;
+        }
+    }
+    // Plus words in query order, each adding what ranking adds; WAND ignores impacts
+    double relevance = 0.0;
+    bool is_matched = false;
+    const auto add_score = [&relevance, &is_matched](int, double score)
+    {
+        relevance += score;
+        is_matched = true;
+    };
+    for (const auto &[postings, inverse_document_freq] : query.plus_postings)
+    {
+        const ImpactList *impacts = is_wand ? nullptr : FindImpacts(*postings);
+        if (impacts != nullptr)
+        {
+            impacts->ForEachImpact(ordinal, ordinal + 1, add_score);
+            continue;
+        }
+        postings->ForEachPosting(ordinal, ordinal + 1, [&add_score, inverse_document_freq = inverse_document_freq](int posting_ordinal, double term_freq)
+                                 { add_score(posting_ordinal, term_freq * inverse_document_freq); });
+    }
+    if (!is_matched)
+    {
+        return after;
+    }
+    return {relevance, documents_[ordinal].rating, after.id};
+}
+
+string SearchServer::MakeQueryCacheKey(const Query &query, DocumentStatus status, size_t max_count)
+{
+    // Valid words have no control characters, so these separators are unambiguous
+    string key;
+    for (const string_view word : query.plus_words)
+    {
+        key.append(word).push_back('\x01');
+    }
+    key.push_back('\x02');
+    for (const string_view word : query.minus_words)
+    {
+        key.append(word).push_back('\x01');
+    }
+    key.push_back('\x02');
+    key += to_string(static_cast<int>(status));
+    key.push_back(' ');
+    key += to_string(max_count);
+    return key;
+}
+
+uint64_t SearchServer::NextGeneration()
 {
-    std::vector<std::string_view> words(document_to_word_freqs_.at(document_id).size());
-    std::transform(policy, document_to_word_freqs_.at(document_id).begin(), document_to_word_freqs_.at(document_id).end(), words.begin(), [](const auto &element)
-                   { return element.first; });
+    static atomic<uint64_t> next_generation = 0;
+    return next_generation.fetch_add(1, memory_order_relaxed);
+}
 
-    for_each(policy, words.begin(), words.end(), [this, document_id](std::string_view elem)
-             { word_to_document_freqs_.find(elem)->second.erase(document_id); });
+double SearchServer::ComputeWordInverseDocumentFreq(const string_view word, const PostingList &postings) const
+{
+    if (const ImpactList *impacts = FindImpacts(postings))
+    {
+        return impacts->GetInverseDocumentFreq();
+    }
+    if (term_statistics_ != nullptr)
+    {
+        return log(term_statistics_->GetDocumentCount() * 1.0 / term_statistics_->GetDocumentFreq(word));
+    }
+    return log(GetDocumentCount() * 1.0 / GetLiveDocumentFreq(postings));
+}
 
-    document_to_word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_ids_.erase(document_id);
+void SearchServer::RemoveDocument(std::execution::parallel_policy policy, int document_id)
+{
+    const int ordinal = document_ordinals_.at(document_id);
+    if (deletion_mode_ == DeletionMode::TOMBSTONE)
+    {
+        MarkRemoved(ordinal);
+    }
+    else
+    {
+        // Distinct words own distinct posting lists, so they can be updated concurrently
+        for_each(policy, word_term_ids_.begin() + word_offsets_[ordinal], word_term_ids_.begin() + word_offsets_[ordinal + 1],
+                 [this, ordinal](uint32_t term_id)
+                 { postings_[term_id].Remove(ordinal); });
+    }
+    EraseDocument(document_id, ordinal);
+    UpdateImpacts(1);
 }
 
-void SearchServer::RemoveDocument(std::execution::sequenced_policy policy, int document_id)
+void SearchServer::RemoveDocument(std::execution::sequenced_policy, int document_id)
 {
     RemoveDocument(document_id);
 }
 
-std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query,
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(std::execution::sequenced_policy, const std::string_view raw_query,
                                                                                       int document_id) const
 {
     return MatchDocument(raw_query, document_id);
@@ -253,33 +1367,189 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
         throw(invalid_argument("ID cannot be less than 0"));
     }
 
-    const auto query = ParseQueryParallel(raw_query);
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    const auto query = ParseQueryParallel(raw_query, &arena);
+    const int ordinal = document_ordinals_.at(document_id);
     vector<string_view> matched_words(query.plus_words.size());
 
-    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, document_id](auto &word)
-               { return word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.find(word)->second.count(document_id); }))
+    if (any_of(policy, query.minus_words.begin(), query.minus_words.end(), [this, ordinal](auto &word)
+               {
+                   const PostingList *postings = FindPostings(word);
+                   return postings != nullptr && postings->Contains(ordinal); }))
     {
         matched_words.clear();
-        return {matched_words, documents_.at(document_id).status};
+        return {matched_words, documents_[ordinal].status};
     }
 
-    auto end = copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [this, document_id, &matched_words](auto &word)
-                       { return word_to_document_freqs_.count(word) != 0 && word_to_document_freqs_.find(word)->second.count(document_id); });
+    auto end = copy_if(policy, query.plus_words.begin(), query.plus_words.end(), matched_words.begin(), [this, ordinal](auto &word)
+                       {
+                           const PostingList *postings = FindPostings(word);
+                           return postings != nullptr && postings->Contains(ordinal); });
     matched_words.resize(end - matched_words.begin());
+    // Point the result into the index rather than into the caller's query string
+    transform(policy, matched_words.begin(), matched_words.end(), matched_words.begin(), [this](auto word)
+              { return terms_[terms_.Find(word)]; });
 
     sort(policy, matched_words.begin(), matched_words.end());
     end = unique(policy, matched_words.begin(), matched_words.end());
     matched_words.resize(end - matched_words.begin());
 
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, documents_[ordinal].status};
+}
+
+template <typename Policy>
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchBatch(const Policy &policy, const string_view raw_query,
+                                                                           const vector<int> &document_ids) const
+{
+    vector<tuple<vector<string_view>, DocumentStatus>> results(document_ids.size());
+    if (document_ids.empty())
+    {
+        return results;
+    }
+    // The first call checks its id before parsing, later calls only their ids
+    if (document_ids[0] < 0)
+    {
+        throw(invalid_argument("ID cannot be less than 0"));
+    }
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    const auto query = ParseQuery(raw_query, &arena);
+    pmr::vector<int> ordinals(&arena);
+    ordinals.reserve(document_ids.size());
+    for (const int document_id : document_ids)
+    {
+        if (document_id < 0)
+        {
+            throw(invalid_argument("ID cannot be less than 0"));
+        }
+        ordinals.push_back(document_ordinals_.at(document_id));
+    }
+
+    // Words of the query that are in the index: plus words in query order, then minus words
+    pmr::vector<uint32_t> term_ids(&arena);
+    term_ids.reserve(query.plus_words.size() + query.minus_words.size());
+    const auto add_terms = [this, &term_ids](const pmr::vector<string_view> &words)
+    {
+        for (const string_view word : words)
+        {
+            const size_t term_id = terms_.Find(word);
+            if (term_id != terms_.size())
+            {
+                term_ids.push_back(static_cast<uint32_t>(term_id));
+            }
+        }
+    };
+    add_terms(query.plus_words);
+    const size_t plus_count = term_ids.size();
+    add_terms(query.minus_words);
+    const size_t term_count = term_ids.size();
+
+    // matches[i * term_count + t] tells whether the i-th document contains term t
+    pmr::vector<char> matches(ordinals.size() * term_count, 0, &arena);
+    pmr::vector<size_t> document_indexes(ordinals.size(), &arena);
+    iota(document_indexes.begin(), document_indexes.end(), 0);
+
+    // Walking a posting list visits each of its blocks and each document; the
+    // forward index visits each word of each document
+    size_t posting_cost = 0;
+    for (const uint32_t term_id : term_ids)
+    {
+        posting_cost += postings_[term_id].GetBlockCount() + ordinals.size();
+    }
+    size_t forward_cost = 0;
+    for (const int ordinal : ordinals)
+    {
+        forward_cost += word_offsets_[ordinal + 1] - word_offsets_[ordinal];
+    }
+
+    if (posting_cost <= forward_cost)
+    {
+        pmr::vector<size_t> sorted_indexes(document_indexes, &arena);
+        sort(sorted_indexes.begin(), sorted_indexes.end(), [&ordinals](size_t lhs, size_t rhs)
+             { return ordinals[lhs] < ordinals[rhs]; });
+        pmr::vector<size_t> terms(term_count, &arena);
+        iota(terms.begin(), terms.end(), 0);
+        for_each(policy, terms.begin(), terms.end(), [&](size_t term)
+                 {
+            PostingList::Cursor cursor(postings_[term_ids[term]]);
+            for (const size_t i : sorted_indexes)
+            {
+                cursor.Seek(ordinals[i]);
+                matches[i * term_count + term] = cursor.GetOrdinal() == ordinals[i];
+            } });
+    }
+    else
+    {
+        pmr::vector<pair<uint32_t, size_t>> sorted_terms(&arena);
+        sorted_terms.reserve(term_count);
+        for (size_t term = 0; term < term_count; ++term)
+        {
+            sorted_terms.emplace_back(term_ids[term], term);
+        }
+        sort(sorted_terms.begin(), sorted_terms.end());
+        for_each(policy, document_indexes.begin(), document_indexes.end(), [&](size_t i)
+                 {
+            const int ordinal = ordinals[i];
+            for (uint64_t word = word_offsets_[ordinal]; word < word_offsets_[ordinal + 1]; ++word)
+            {
+                // A word can be both a plus and a minus word
+                for (auto it = lower_bound(sorted_terms.begin(), sorted_terms.end(), pair{word_term_ids_[word], size_t{0}});
+                     it != sorted_terms.end() && it->first == word_term_ids_[word]; ++it)
+                {
+                    matches[i * term_count + it->second] = true;
+                }
+            } });
+    }
+
+    for_each(policy, document_indexes.begin(), document_indexes.end(), [&](size_t i)
+             {
+        const char *document_matches = matches.data() + i * term_count;
+        vector<string_view> matched_words;
+        if (none_of(document_matches + plus_count, document_matches + term_count, [](char match)
+                    { return match; }))
+        {
+            matched_words.reserve(count(document_matches, document_matches + plus_count, true));
+            for (size_t term = 0; term < plus_count; ++term)
+            {
+                if (document_matches[term])
+                {
+                    matched_words.push_back(terms_[term_ids[term]]);
+                }
+            }
+        }
+        results[i] = {move(matched_words), documents_[ordinals[i]].status}; });
+    return results;
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(const string_view raw_query,
+                                                                               const vector<int> &document_ids) const
+{
+    return MatchBatch(execution::seq, raw_query, document_ids);
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(execution::sequenced_policy policy, const string_view raw_query,
+                                                                               const vector<int> &document_ids) const
+{
+    return MatchBatch(policy, raw_query, document_ids);
+}
+
+vector<tuple<vector<string_view>, DocumentStatus>> SearchServer::MatchDocuments(execution::parallel_policy policy, const string_view raw_query,
+                                                                               const vector<int> &document_ids) const
+{
+    return MatchBatch(policy, raw_query, document_ids);
 }
 
-SearchServer::QueryParallel SearchServer::ParseQueryParallel(const std::string_view text) const
+SearchServer::QueryParallel SearchServer::ParseQueryParallel(const std::string_view text, std::pmr::memory_resource *resource) const
 {
-    QueryParallel result;
-    for (const std::string_view word : SplitIntoWords(text))
+    INSTRUMENT_STAGE(QueryStage::PARSE);
+    QueryParallel result(resource);
+    std::pmr::vector<std::string_view> words(resource);
+    const size_t invalid_word = SplitIntoWords(text, words);
+    for (size_t i = 0; i < words.size(); ++i)
     {
-        const auto query_word = ParseQueryWord(word);
+        // Parsing stops at the first invalid word, so later words are never checked
+        const auto query_word = ParseQueryWord(words[i], i < invalid_word);
         if (!query_word.is_stop)
         {
             if (query_word.is_minus)
@@ -293,4 +1563,169 @@ SearchServer::QueryParallel SearchServer::ParseQueryParallel(const std::string_v
         }
     }
     return result;
-}
\ No newline at end of file
+}
+void SearchServer::SaveIndex(const std::string &path) const
+{
+    // A server loaded from path may still map it, so the file is replaced
+    // with a new one instead of being overwritten in place
+    const string temp_path = path + ".tmp"s;
+    try
+    {
+        WriteSnapshot(temp_path);
+        SyncFile(temp_path);
+    }
+    catch (...)
+    {
+        remove(temp_path.c_str());
+        throw;
+    }
+    if (rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        remove(temp_path.c_str());
+        throw runtime_error("Cannot write "s + path);
+    }
+}
+
+void SearchServer::WriteSnapshot(const std::string &path) const
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    if (!out)
+    {
+        throw runtime_error("Cannot open "s + path);
+    }
+    SnapshotWriter writer(out);
+    writer.WriteStrings(vector<string_view>(stop_words_.begin(), stop_words_.end()));
+
+    // Terms are saved sorted, so the loaded index can find them by binary search
+    vector<uint32_t> sorted_term_ids(terms_.size());
+    iota(sorted_term_ids.begin(), sorted_term_ids.end(), 0);
+    sort(sorted_term_ids.begin(), sorted_term_ids.end(), [this](uint32_t lhs, uint32_t rhs)
+         { return terms_[lhs] < terms_[rhs]; });
+    vector<string_view> sorted_terms;
+    sorted_terms.reserve(terms_.size());
+    for (const uint32_t term_id : sorted_term_ids)
+    {
+        sorted_terms.push_back(terms_[term_id]);
+    }
+    writer.WriteStrings(sorted_terms);
+
+    writer.WriteValue(static_cast<uint32_t>(index_storage_));
+    writer.WriteArray(documents_);
+    vector<int> ids;
+    vector<int> ordinals;
+    for (const auto [id, ordinal] : document_ordinals_)
+    {
+        ids.push_back(id);
+        ordinals.push_back(ordinal);
+    }
+    writer.WriteArray(ids);
+    writer.WriteArray(ordinals);
+
+    // Word frequencies are kept exactly, as compressed postings quantize them
+    vector<uint64_t> word_offsets(documents_.size() + 1, 0);
+    vector<uint32_t> word_term_ids;
+    vector<double> word_term_freqs;
+    vector<uint32_t> sorted_positions(terms_.size());
+    for (size_t position = 0; position < sorted_term_ids.size(); ++position)
+    {
+        sorted_positions[sorted_term_ids[position]] = static_cast<uint32_t>(position);
+    }
+    for (size_t ordinal = 0; ordinal < documents_.size(); ++ordinal)
+    {
+        const int id = documents_[ordinal].id;
+        const auto it = document_ordinals_.find(id);
+        if (it != document_ordinals_.end() && it->second == static_cast<int>(ordinal))
+        {
+            for (uint64_t i = word_offsets_[ordinal]; i < word_offsets_[ordinal + 1]; ++i)
+            {
+                word_term_ids.push_back(sorted_positions[word_term_ids_[i]]);
+                word_term_freqs.push_back(word_term_freqs_[i]);
+            }
+        }
+        word_offsets[ordinal + 1] = word_term_ids.size();
+    }
+    writer.WriteArray(word_offsets);
+    writer.WriteArray(word_term_ids);
+    writer.WriteArray(word_term_freqs);
+
+    for (const uint32_t term_id : sorted_term_ids)
+    {
+        if (term_id < removed_posting_counts_.size() && removed_posting_counts_[term_id] > 0)
+        {
+            // The snapshot keeps no marks, so postings of removed documents are left out
+            PostingList postings = postings_[term_id];
+            postings.RemoveIf([this](int ordinal)
+                              { return IsRemoved(ordinal); });
+            postings.Save(writer);
+            continue;
+        }
+        postings_[term_id].Save(writer);
+    }
+    if (!out.flush())
+    {
+        throw runtime_error("Cannot write "s + path);
+    }
+}
+
+SearchServer SearchServer::LoadIndex(const std::string &path)
+{
+    auto snapshot = make_shared<const MappedFile>(path);
+    SnapshotReader reader(*snapshot);
+    const vector<string_view> stop_words = reader.ReadStrings();
+    if (!all_of(stop_words.begin(), stop_words.end(), IsValidWord))
+    {
+        SnapshotReader::ThrowCorrupted();
+    }
+    SearchServer server(stop_words);
+    vector<string_view> terms = reader.ReadStrings();
+    if (!is_sorted(terms.begin(), terms.end()))
+    {
+        SnapshotReader::ThrowCorrupted();
+    }
+    server.terms_.AssignSorted(move(terms));
+
+    const auto index_storage = reader.ReadValue<uint32_t>();
+    if (index_storage > static_cast<uint32_t>(IndexStorage::COMPRESSED))
+    {
+        SnapshotReader::ThrowCorrupted();
+    }
+    server.index_storage_ = static_cast<IndexStorage>(index_storage);
+    server.documents_ = reader.ReadArray<DocumentData>();
+    const auto ids = reader.ReadArray<int>();
+    const auto ordinals = reader.ReadArray<int>();
+    if (ids.size() != ordinals.size())
+    {
+        SnapshotReader::ThrowCorrupted();
+    }
+    // Ids are saved in ascending order, so every insertion goes to the end
+    for (size_t i = 0; i < ids.size(); ++i)
+    {
+        if (ordinals[i] < 0 || static_cast<size_t>(ordinals[i]) >= server.documents_.size())
+        {
+            SnapshotReader::ThrowCorrupted();
+        }
+        server.document_ordinals_.emplace_hint(server.document_ordinals_.end(), ids[i], ordinals[i]);
+        server.document_ids_.emplace_hint(server.document_ids_.end(), ids[i]);
+    }
+
+    server.word_offsets_ = reader.ReadArray<uint64_t>();
+    server.word_term_ids_ = reader.ReadArray<uint32_t>();
+    server.word_term_freqs_ = reader.ReadArray<double>();
+    if (server.word_offsets_.size() != server.documents_.size() + 1 || server.word_offsets_[0] != 0
+        || !is_sorted(server.word_offsets_.begin(), server.word_offsets_.end())
+        || server.word_offsets_.back() != server.word_term_ids_.size()
+        || server.word_term_freqs_.size() != server.word_term_ids_.size()
+        || any_of(server.word_term_ids_.begin(), server.word_term_ids_.end(), [&server](uint32_t term_id)
+                  { return term_id >= server.terms_.size(); }))
+    {
+        SnapshotReader::ThrowCorrupted();
+    }
+
+    server.postings_.reserve(server.terms_.size());
+    for (size_t term_id = 0; term_id < server.terms_.size(); ++term_id)
+    {
+        server.postings_.push_back(PostingList::Load(reader, server.documents_.size()));
+    }
+    server.snapshot_ = move(snapshot);
+    return server;
+}
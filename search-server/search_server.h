@@ -1,16 +1,36 @@
 #pragma once
-#include "concurrent_map.h"
+#include "array_storage.h"
 #include "document.h"
-#include "log_duration.h"
+#include "document_fingerprint.h"
+#include "impact_list.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
+#include "posting_list.h"
+#include "query_arena.h"
+#include "query_result_cache.h"
+#include "score_accumulator.h"
+#include "search_cursor.h"
 #include "string_processing.h"
+#include "term_dictionary.h"
+#include "term_statistics.h"
+#include "top_documents.h"
 #include <algorithm>
+#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <execution>
+#include <limits>
 #include <map>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <numeric>
 #include <set>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -18,6 +38,67 @@ const int MAX_RESULT_DOCUMENT_COUNT = 5;
 
 const double DEVIATION = 1e-6;
 
+enum class IndexStorage
+{
+    // Posting lists hold plain arrays of ordinals and term frequencies
+    PLAIN,
+    // Posting lists are bit-packed in blocks with delta-encoded ordinals and
+    // term frequencies quantized to 16 bits, about four times smaller than PLAIN.
+    // Quantization shifts relevance by up to 1e-5 of the block's maximum term
+    // frequency times the inverse document frequency
+    COMPRESSED,
+};
+
+enum class QueryEvaluation
+{
+    // Scores every posting of every query word
+    EXHAUSTIVE,
+    // Document-at-a-time WAND with block-max skipping: documents whose score
+    // upper bound cannot reach the current top are never scored. Results are
+    // the same as with EXHAUSTIVE. Applies to sequential searches only
+    WAND,
+};
+
+// What AddDocument and AddDocuments do with a document whose set of words,
+// stop words excluded, equals that of a document in the index. Documents are
+// compared by DocumentFingerprint
+enum class DuplicateDetection
+{
+    // Duplicates are added; RemoveDuplicates finds them with a full scan
+    OFF,
+    // Duplicates are added and listed by GetFlaggedDuplicates
+    FLAG,
+    // Duplicates are rejected with std::invalid_argument
+    REJECT,
+};
+
+// What RemoveDocument does with the postings of the removed document
+enum class DeletionMode
+{
+    // Takes the document out of every posting list of its words at once
+    IMMEDIATE,
+    // Only marks the document removed: searches skip it and count it out of
+    // document frequencies, and CompactIndex takes it out of the posting lists
+    TOMBSTONE,
+};
+
+// Whether searches score words from precomputed impacts, see ImpactList.
+// Impacts are built with the inverse document frequencies of the time and
+// rebuilt all at once when the corpus has drifted past the refresh tolerance.
+// Until then the document count is off by at most that share, so a word's
+// inverse document frequency is off by at most -ln(1 - tolerance), and so is
+// relevance, as a document's term frequencies sum to at most one. With a
+// tolerance of 0, float impacts stay within DEVIATION of the exact relevance.
+// Words whose postings changed since are scored from term frequencies
+enum class ImpactScoring
+{
+    OFF,
+    // Impacts are floats
+    FLOAT,
+    // Impacts are quantized to 16 bits, see ImpactList
+    QUANTIZED,
+};
+
 class SearchServer
 {
 public:
@@ -29,29 +110,163 @@ public:
 
     void AddDocument(int document_id, const std::string &document, DocumentStatus status,
                      const std::vector<int> &ratings);
+    // Adds all documents or none: throws the error AddDocument would throw for
+    // the first invalid document. The parallel version tokenizes slices of the
+    // batch into partial indexes on different threads and merges them per word
+    void AddDocuments(const std::vector<NewDocument> &documents);
+    void AddDocuments(std::execution::sequenced_policy policy, const std::vector<NewDocument> &documents);
+    void AddDocuments(std::execution::parallel_policy policy, const std::vector<NewDocument> &documents);
+    // Adds the documents of another index, except skipped_ids, with the same
+    // words, term frequencies, statuses and ratings. Adds all documents or
+    // none, with the errors AddDocuments would throw
+    void AddDocumentsFrom(const SearchServer &other, const std::set<int> &skipped_ids = {});
 
+    // max_count limits the number of returned documents
     template <typename DocumentPredicate>
     std::vector<Document> FindTopDocuments(const std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename DocumentPredicate, typename Policy>
     std::vector<Document> FindTopDocuments(const Policy &policy, std::string_view raw_query,
-                                           DocumentPredicate document_predicate) const;
+                                           DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
-    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
     template <typename Policy>
-    std::vector<Document> FindTopDocuments(const Policy &policy, const std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(const Policy &policy, const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
 
     std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
     template <typename Policy>
     std::vector<Document> FindTopDocuments(const Policy &policy, const std::string_view raw_query) const;
 
+    // The results ranked from offset on, at most limit of them: a page of what
+    // FindTopDocuments with max_count offset + limit would return. Only that
+    // many documents are kept while ranking. Not cached
+    template <typename DocumentPredicate, typename Policy>
+    std::vector<Document> FindTopDocumentsPage(const Policy &policy, const std::string_view raw_query,
+                                               DocumentPredicate document_predicate, size_t offset, size_t limit) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsPage(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                               size_t offset, size_t limit) const;
+    std::vector<Document> FindTopDocumentsPage(const std::string_view raw_query, DocumentStatus status,
+                                               size_t offset, size_t limit) const;
+    std::vector<Document> FindTopDocumentsPage(const std::string_view raw_query, size_t offset, size_t limit) const;
+
+    // The first limit results ranked below the cursor, usually made from the
+    // last document of the previous page. Only limit documents are kept while
+    // ranking, however deep the page is. Not cached.
+    // The cursor stands where its document ranks now, so pages stay contiguous
+    // while documents are removed between them, as long as the rest keep their
+    // order: always for one-word queries. Once the cursor's own document is
+    // removed, its saved relevance is used
+    template <typename DocumentPredicate, typename Policy>
+    std::vector<Document> FindTopDocumentsAfter(const Policy &policy, const std::string_view raw_query,
+                                                DocumentPredicate document_predicate, const SearchCursor &after,
+                                                size_t limit) const;
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocumentsAfter(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                const SearchCursor &after, size_t limit) const;
+    std::vector<Document> FindTopDocumentsAfter(const std::string_view raw_query, DocumentStatus status,
+                                                const SearchCursor &after, size_t limit) const;
+    std::vector<Document> FindTopDocumentsAfter(const std::string_view raw_query, const SearchCursor &after,
+                                                size_t limit) const;
+
+    // Same results as FindTopDocuments(raw_query) for every query. All queries
+    // are parsed first and every distinct word's postings and inverse document
+    // frequency are looked up once per batch. The parallel version scores
+    // different queries on different threads. Throws the error of the first
+    // invalid query
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(const std::vector<std::string> &raw_queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::execution::sequenced_policy policy,
+                                                             const std::vector<std::string> &raw_queries) const;
+    std::vector<std::vector<Document>> FindTopDocumentsBatch(std::execution::parallel_policy policy,
+                                                             const std::vector<std::string> &raw_queries) const;
+
+    // Converts every posting list; switching back to PLAIN keeps the quantized frequencies
+    void SetIndexStorage(IndexStorage index_storage);
+    IndexStorage GetIndexStorage() const;
+
+    void SetQueryEvaluation(QueryEvaluation query_evaluation);
+    QueryEvaluation GetQueryEvaluation() const;
+
+    // Switching scoring on or between modes builds impacts for every word.
+    // WAND still walks term frequencies, with the impacts' inverse document
+    // frequencies. Not saved in snapshots
+    void SetImpactScoring(ImpactScoring impact_scoring);
+    ImpactScoring GetImpactScoring() const;
+    // Impacts are rebuilt once the documents added and removed since the last
+    // build, or the change of the document count, exceed this share of the
+    // document count then. 0 rebuilds them on every change
+    void SetImpactRefreshTolerance(double tolerance);
+    double GetImpactRefreshTolerance() const;
+    // Rebuilds the impacts of every word now, for instance after the term
+    // statistics changed without this index changing
+    void RefreshImpacts();
+
+    // Switching detection on fingerprints the documents already in the index,
+    // switching it off forgets fingerprints and flags. Not saved in snapshots
+    void SetDuplicateDetection(DuplicateDetection duplicate_detection);
+    DuplicateDetection GetDuplicateDetection() const;
+    // Documents added while FLAG was set that duplicated a document in the
+    // index, as long as they are in the index themselves
+    const std::set<int> &GetFlaggedDuplicates() const;
+
+    // Caches results of searches by status, the default ACTUAL one included, in
+    // an LRU cache of about capacity results; 0 disables the cache. Any change
+    // of the index invalidates all cached results. Copies of the server share
+    // the cache
+    void SetQueryCacheCapacity(size_t capacity);
+    size_t GetQueryCacheCapacity() const;
+    // All zeros while the cache is disabled
+    QueryCacheStats GetQueryCacheStats() const;
+
+    // Inverse document frequencies are computed from statistics instead of
+    // this index; nullptr restores the index's own counts. The statistics must
+    // outlive the server and are read on every search. Cached results are not
+    // invalidated when they change. Not saved in snapshots
+    void SetTermStatistics(const TermStatistics *statistics);
+    const TermStatistics *GetTermStatistics() const;
+
     int GetDocumentCount() const;
+    // Number of documents in this index containing the word
+    size_t GetDocumentFreq(const std::string_view word) const;
     std::set<int>::iterator begin();
     std::set<int>::iterator end();
+    std::set<int>::const_iterator begin() const;
+    std::set<int>::const_iterator end() const;
+    // The map is built on first request and lives until the document is removed
     const std::map<std::string_view, double, std::less<>> &GetWordFrequencies(int document_id) const;
+    // Equal for documents with the same set of words, stop words excluded
+    DocumentFingerprint GetDocumentFingerprint(int document_id) const;
     void RemoveDocument(int document_id);
     void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
     void RemoveDocument(std::execution::parallel_policy policy, int document_id);
+    // Removes all documents or none: throws std::out_of_range if an id is not
+    // in the index or is listed twice. With IMMEDIATE every affected posting
+    // list is rewritten once for the whole batch; the parallel version
+    // rewrites different lists on different threads
+    void RemoveDocuments(const std::vector<int> &document_ids);
+    void RemoveDocuments(std::execution::sequenced_policy policy, const std::vector<int> &document_ids);
+    void RemoveDocuments(std::execution::parallel_policy policy, const std::vector<int> &document_ids);
+
+    // Switching to IMMEDIATE takes the documents removed so far out of the
+    // posting lists. Not saved in snapshots
+    void SetDeletionMode(DeletionMode deletion_mode);
+    DeletionMode GetDeletionMode() const;
+    // Takes removed documents out of the posting lists and the forward index
+    // and drops words no document contains any more, renumbering the rest.
+    // Live documents are renumbered too, so removed ones stop costing memory
+    // and per-query scratch.
+    // string_views handed out earlier stay valid. The parallel version
+    // rewrites different posting lists on different threads
+    void CompactIndex();
+    void CompactIndex(std::execution::sequenced_policy policy);
+    void CompactIndex(std::execution::parallel_policy policy);
+    // Words of removed documents still held by the index until CompactIndex:
+    // in the posting lists with TOMBSTONE, in the forward index either way
+    size_t GetRemovedWordCount() const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
                                                                             int document_id) const;
@@ -60,56 +275,252 @@ public:
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query,
                                                                             int document_id) const;
 
+    // Same results as MatchDocument(raw_query, id) for every id, and the error
+    // the first failing call would throw. The query is parsed and its words are
+    // looked up once; then either every word's postings are walked once over the
+    // sorted documents or the documents' words are scanned, whichever visits
+    // fewer entries. The parallel version spreads words or documents over threads
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(const std::string_view raw_query,
+                                                                                          const std::vector<int> &document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::execution::sequenced_policy policy, const std::string_view raw_query,
+                                                                                          const std::vector<int> &document_ids) const;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(std::execution::parallel_policy policy, const std::string_view raw_query,
+                                                                                          const std::vector<int> &document_ids) const;
+
+    // Writes the whole index to a versioned binary snapshot. The snapshot is
+    // written next to path and renamed over it, so servers loaded from the
+    // old file keep serving it. Throws std::runtime_error if the file cannot
+    // be written
+    void SaveIndex(const std::string &path) const;
+    // Maps a snapshot read-only and serves queries from the mapped pages;
+    // only document ids and the term array are built on the heap. Parts of
+    // the index are copied to the heap when they are changed. Throws
+    // std::runtime_error if the file is missing or is not a valid snapshot
+    static SearchServer LoadIndex(const std::string &path);
+
 private:
     struct DocumentData
     {
+        int id = 0;
         int rating = 0;
         DocumentStatus status;
-        std::vector<std::string> data;
     };
+    using WordFrequencies = std::map<std::string_view, double, std::less<>>;
+
+    // Maps built by GetWordFrequencies, keyed by ordinal. A copy of the server
+    // starts with an empty cache
+    struct WordFrequencyCache
+    {
+        WordFrequencyCache() = default;
+        WordFrequencyCache(const WordFrequencyCache &)
+        {
+        }
+        WordFrequencyCache &operator=(const WordFrequencyCache &)
+        {
+            std::lock_guard lock(mutex);
+            ordinal_to_word_freqs.clear();
+            return *this;
+        }
+
+        std::mutex mutex;
+        std::map<int, WordFrequencies> ordinal_to_word_freqs;
+    };
+
     const std::set<std::string, std::less<>> stop_words_;
-    std::map<std::string_view, std::map<int, double>, std::less<>> word_to_document_freqs_;
-    std::map<int, std::map<std::string_view, double, std::less<>>> document_to_word_freqs_;
-    std::map<int, DocumentData> documents_;
+    // Term ids index postings_. All string_views of the index point into terms_
+    TermDictionary terms_;
+    std::vector<PostingList> postings_;
+    // Documents are numbered with dense ordinals in the order they were added;
+    // postings and query scratch are indexed by ordinal. Ordinals of removed
+    // documents are not reused until CompactIndex renumbers the live ones in
+    // the same order, so postings stay sorted by appending
+    ArrayStorage<DocumentData> documents_;
+    std::map<int, int> document_ordinals_;
     std::set<int> document_ids_;
+    // Forward index: the distinct words of the document with ordinal i are the
+    // term ids and frequencies at [word_offsets_[i], word_offsets_[i + 1]).
+    // Words of removed documents stay until CompactIndex or the next snapshot
+    ArrayStorage<uint64_t> word_offsets_ = ArrayStorage<uint64_t>(std::vector<uint64_t>{0});
+    ArrayStorage<uint32_t> word_term_ids_;
+    ArrayStorage<double> word_term_freqs_;
+    mutable WordFrequencyCache word_freqs_cache_;
+    IndexStorage index_storage_ = IndexStorage::PLAIN;
+    QueryEvaluation query_evaluation_ = QueryEvaluation::EXHAUSTIVE;
+    DuplicateDetection duplicate_detection_ = DuplicateDetection::OFF;
+    DeletionMode deletion_mode_ = DeletionMode::IMMEDIATE;
+    // Documents removed with TOMBSTONE whose postings are still in the index,
+    // one bit per ordinal; empty when there are none
+    std::vector<uint64_t> removed_ordinals_;
+    // Postings of those documents in each posting list, by term id; may be
+    // shorter than postings_
+    std::vector<uint32_t> removed_posting_counts_;
+    size_t removed_word_count_ = 0;
+    ImpactScoring impact_scoring_ = ImpactScoring::OFF;
+    double impact_refresh_tolerance_ = 0.05;
+    // Impacts by term id; empty for words whose postings changed since they
+    // were built and words added since, and altogether while scoring is off.
+    // Lists never change, so copies of the server share them
+    std::vector<std::shared_ptr<const ImpactList>> impacts_;
+    // Document count the impacts were built with, and documents added or
+    // removed since
+    int impact_document_count_ = 0;
+    size_t impact_changed_document_count_ = 0;
+    // Number of documents in the index with each fingerprint, while detection is on
+    std::unordered_map<DocumentFingerprint, int, DocumentFingerprintHash> fingerprint_counts_;
+    std::set<int> flagged_duplicates_;
+    // Mapped snapshot the index was loaded from, if any; shared by copies
+    std::shared_ptr<const MappedFile> snapshot_;
+    std::shared_ptr<QueryResultCache> query_cache_;
+    const TermStatistics *term_statistics_ = nullptr;
+    // Changes with every change of the index. Generations are unique across
+    // all servers, so copies can share cached results
+    uint64_t generation_ = NextGeneration();
+
+    static uint64_t NextGeneration();
 
     bool IsStopWord(const std::string_view word) const;
 
+    template <typename Policy>
+    void IndexDocuments(const Policy &policy, const std::vector<NewDocument> &documents);
+
+    bool IsRemoved(int ordinal) const
+    {
+        const size_t word = static_cast<size_t>(ordinal) / 64;
+        return word < removed_ordinals_.size() && (removed_ordinals_[word] >> (ordinal % 64) & 1) != 0;
+    }
+    // Documents of the index containing the word, those marked removed excluded
+    size_t GetLiveDocumentFreq(const PostingList &postings) const;
+    // Marks the document removed and counts its postings as removed
+    void MarkRemoved(int ordinal);
+    // Takes the postings of documents marked removed out of the posting lists
+    template <typename Policy>
+    void PurgeRemovedPostings(const Policy &policy);
+    // Forgets the id of a document whose postings are taken care of
+    void EraseDocument(int document_id, int ordinal);
+
+    // Impacts of the word if they are up to date, otherwise nullptr
+    const ImpactList *FindImpacts(const PostingList &postings) const
+    {
+        const size_t term_id = &postings - postings_.data();
+        return term_id < impacts_.size() ? impacts_[term_id].get() : nullptr;
+    }
+    // Drops the impacts of a word whose postings changed
+    void DropImpacts(size_t term_id)
+    {
+        if (term_id < impacts_.size())
+        {
+            impacts_[term_id].reset();
+        }
+    }
+    // Counts documents added or removed and rebuilds the impacts if the corpus
+    // has drifted past the tolerance
+    void UpdateImpacts(size_t changed_document_count);
+
+    template <typename Policy>
+    void RemoveBatch(const Policy &policy, const std::vector<int> &document_ids);
+    template <typename Policy>
+    void Compact(const Policy &policy);
+
+    size_t InternTerm(const std::string_view word);
+    // Returns nullptr if the word is not in the index
+    const PostingList *FindPostings(const std::string_view word) const;
+
     static bool IsValidWord(const std::string_view word);
 
     std::vector<std::string_view> SplitIntoWordsNoStop(std::string_view text) const;
 
+    DocumentFingerprint ComputeFingerprint(int ordinal) const;
+    // Writes the snapshot SaveIndex saves, in place
+    void WriteSnapshot(const std::string &path) const;
+    // Throws if REJECT is set and a document in the index has the fingerprint
+    void CheckDuplicate(int document_id, const DocumentFingerprint &fingerprint) const;
+    // Counts a document added while detection is on, flagging it if needed
+    void AddFingerprint(int document_id, const DocumentFingerprint &fingerprint);
+    void RemoveFingerprint(int document_id, int ordinal);
+
     struct QueryWord
     {
         std::string_view data;
         bool is_minus = false;
         bool is_stop = false;
     };
-    QueryWord ParseQueryWord(const std::string_view text) const;
+    // is_valid tells whether the word is free of control characters
+    QueryWord ParseQueryWord(const std::string_view text, bool is_valid) const;
 
+    // Words are sorted and unique. A query and everything derived from it take
+    // memory from the resource it was parsed with: the thread's QueryArena on
+    // the query path, so parsing and ranking do not touch the heap
     struct Query
     {
-        std::set<std::string_view> plus_words;
-        std::set<std::string_view> minus_words;
+        explicit Query(std::pmr::memory_resource *resource = std::pmr::get_default_resource())
+            : plus_words(resource), minus_words(resource)
+        {
+        }
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
     };
 
+    // Words in query order, duplicates kept
     struct QueryParallel
     {
-        std::vector<std::string_view> plus_words;
-        std::vector<std::string_view> minus_words;
+        explicit QueryParallel(std::pmr::memory_resource *resource)
+            : plus_words(resource), minus_words(resource)
+        {
+        }
+
+        std::pmr::vector<std::string_view> plus_words;
+        std::pmr::vector<std::string_view> minus_words;
     };
 
-    Query ParseQuery(const std::string_view text) const;
-    QueryParallel ParseQueryParallel(const std::string_view text) const;
-    // Existence required
-    double ComputeWordInverseDocumentFreq(const std::string_view word) const;
+    Query ParseQuery(const std::string_view text, std::pmr::memory_resource *resource) const;
+
+    // Query words resolved to the index, in the order of the parsed query.
+    // Plus words have postings of documents not marked removed; absent words
+    // are dropped
+    struct ResolvedQuery
+    {
+        explicit ResolvedQuery(std::pmr::memory_resource *resource)
+            : plus_postings(resource), minus_postings(resource)
+        {
+        }
+
+        std::pmr::vector<std::pair<const PostingList *, double>> plus_postings;
+        std::pmr::vector<const PostingList *> minus_postings;
+    };
+    ResolvedQuery ResolveQuery(const Query &query) const;
+    // Sorted words, status and count identify cached results
+    static std::string MakeQueryCacheKey(const Query &query, DocumentStatus status, size_t max_count);
+    QueryParallel ParseQueryParallel(const std::string_view text, std::pmr::memory_resource *resource) const;
+    // The cursor with the relevance its document has now, summed as ranking
+    // sums it. Inverse document frequencies change with the index, so the
+    // relevance saved with an earlier page may no longer separate the same
+    // documents. Unchanged if the document is gone or the query skips it
+    SearchCursor AnchorCursor(const ResolvedQuery &query, const SearchCursor &after, bool is_wand) const;
+    // postings are the word's and must hold a document not marked removed.
+    // Words with impacts keep the inverse document frequency they were built with
+    double ComputeWordInverseDocumentFreq(const std::string_view word, const PostingList &postings) const;
+
+    template <typename Policy>
+    std::vector<std::vector<Document>> SearchBatch(const Policy &policy, const std::vector<std::string> &raw_queries) const;
+    template <typename Policy>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchBatch(const Policy &policy, const std::string_view raw_query,
+                                                                                      const std::vector<int> &document_ids) const;
 
     template <typename DocumentPredicate, typename Policy>
-    std::vector<Document> FindAllDocuments(const Policy &policy, const Query &query,
-                                           DocumentPredicate document_predicate) const;
+    std::vector<Document> RankDocuments(const Policy &policy, const ResolvedQuery &query,
+                                        DocumentPredicate document_predicate, TopDocuments top_documents) const;
     template <typename DocumentPredicate>
-    std::vector<Document> FindAllDocumentsParallel(const Query &query,
-                                                   DocumentPredicate document_predicate) const;
+    void FindAllDocuments(const ResolvedQuery &query, DocumentPredicate document_predicate,
+                          TopDocuments &top_documents) const;
+    template <typename DocumentPredicate>
+    void FindAllDocumentsWand(const ResolvedQuery &query, DocumentPredicate document_predicate,
+                              TopDocuments &top_documents) const;
+    // Splits the ordinal range into slices scored independently on different
+    // threads, so no state is shared between threads until the heaps are merged
+    template <typename DocumentPredicate>
+    void FindAllDocumentsParallel(const ResolvedQuery &query, DocumentPredicate document_predicate,
+                                  TopDocuments &top_documents) const;
 };
 
 template <typename StringContainer>
@@ -124,131 +535,357 @@ SearchServer::SearchServer(const StringContainer &stop_words)
 
 template <typename DocumentPredicate>
 std::vector<Document> SearchServer::FindTopDocuments(const std::string_view raw_query,
-                                                     DocumentPredicate document_predicate) const
+                                                     DocumentPredicate document_predicate,
+                                                     size_t max_count) const
 {
-    return FindTopDocuments(std::execution::seq, raw_query, document_predicate);
+    return FindTopDocuments(std::execution::seq, raw_query, document_predicate, max_count);
 }
 
 template <typename DocumentPredicate, typename Policy>
 std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const std::string_view raw_query,
-                                                     DocumentPredicate document_predicate) const
+                                                     DocumentPredicate document_predicate,
+                                                     size_t max_count) const
 {
-    const auto query = ParseQuery(raw_query);
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    return RankDocuments(policy, ResolveQuery(ParseQuery(raw_query, &arena)), document_predicate, TopDocuments(max_count));
+}
 
-    auto matched_documents = FindAllDocuments(policy, query, document_predicate);
+template <typename Policy>
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const std::string_view raw_query, DocumentStatus status,
+                                                     size_t max_count) const
+{
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    const auto query = ParseQuery(raw_query, &arena);
+    const auto status_predicate = [status](int, DocumentStatus document_status, int)
+    { return document_status == status; };
+    if (query_cache_ == nullptr)
+    {
+        return RankDocuments(policy, ResolveQuery(query), status_predicate, TopDocuments(max_count));
+    }
 
-    sort(policy, matched_documents.begin(), matched_documents.end(),
-         [](const Document &lhs, const Document &rhs)
-         {
-             return lhs.relevance > rhs.relevance || (std::abs(lhs.relevance - rhs.relevance) < DEVIATION && lhs.rating > rhs.rating);
-         });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT)
+    const std::string key = MakeQueryCacheKey(query, status, max_count);
+    if (auto documents = query_cache_->Find(key, generation_))
     {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+        return std::move(*documents);
     }
-    return matched_documents;
+    auto documents = RankDocuments(policy, ResolveQuery(query), status_predicate, TopDocuments(max_count));
+    query_cache_->Insert(key, generation_, documents);
+    return documents;
 }
 
 template <typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const std::string_view raw_query, DocumentStatus status) const
+std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const std::string_view raw_query) const
 {
+    return FindTopDocuments(policy, raw_query, DocumentStatus::ACTUAL);
+}
 
-    return FindTopDocuments(policy,
-                            raw_query, [status](int document_id, DocumentStatus document_status, int rating)
-                            { return document_status == status; });
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::FindTopDocumentsPage(const Policy &policy, const std::string_view raw_query,
+                                                         DocumentPredicate document_predicate, size_t offset, size_t limit) const
+{
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    const size_t max_count = limit > std::numeric_limits<size_t>::max() - offset ? std::numeric_limits<size_t>::max() : offset + limit;
+    auto documents = RankDocuments(policy, ResolveQuery(ParseQuery(raw_query, &arena)), document_predicate, TopDocuments(max_count));
+    documents.erase(documents.begin(), documents.begin() + std::min(offset, documents.size()));
+    return documents;
 }
-template <typename Policy>
-std::vector<Document> SearchServer::FindTopDocuments(const Policy &policy, const std::string_view raw_query) const
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsPage(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                         size_t offset, size_t limit) const
 {
-    return FindTopDocuments(policy,
-                            raw_query, [](int document_id, DocumentStatus document_status, int rating)
-                            { return document_status == DocumentStatus::ACTUAL; });
+    return FindTopDocumentsPage(std::execution::seq, raw_query, document_predicate, offset, limit);
 }
 
 template <typename DocumentPredicate, typename Policy>
-std::vector<Document> SearchServer::FindAllDocuments(const Policy &policy, const Query &query,
-                                                     DocumentPredicate document_predicate) const
+std::vector<Document> SearchServer::FindTopDocumentsAfter(const Policy &policy, const std::string_view raw_query,
+                                                          DocumentPredicate document_predicate, const SearchCursor &after,
+                                                          size_t limit) const
 {
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    const ResolvedQuery query = ResolveQuery(ParseQuery(raw_query, &arena));
+    const bool is_wand = std::is_same_v<std::remove_reference_t<Policy>, std::execution::sequenced_policy>
+                         && query_evaluation_ == QueryEvaluation::WAND;
+    const SearchCursor anchor = AnchorCursor(query, after, is_wand);
+    return RankDocuments(policy, query, document_predicate, TopDocuments(limit, {anchor.id, anchor.relevance, anchor.rating}));
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SearchServer::FindTopDocumentsAfter(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                                          const SearchCursor &after, size_t limit) const
+{
+    return FindTopDocumentsAfter(std::execution::seq, raw_query, document_predicate, after, limit);
+}
+
+template <typename DocumentPredicate, typename Policy>
+std::vector<Document> SearchServer::RankDocuments(const Policy &, const ResolvedQuery &query,
+                                                  DocumentPredicate document_predicate, TopDocuments top_documents) const
+{
+    // No document can be kept, and WAND would read the lowest of an empty top
+    if (top_documents.GetMaxCount() == 0)
+    {
+        return {};
+    }
     if constexpr (std::is_same_v<std::remove_reference_t<Policy>,
                                  std::execution::sequenced_policy>)
     {
-        std::map<int, double> document_to_relevance;
-        for (const std::string_view word : query.plus_words)
+        if (query_evaluation_ == QueryEvaluation::WAND)
         {
-            if (word_to_document_freqs_.count(word) == 0)
+            INSTRUMENT_STAGE(QueryStage::POSTINGS);
+            FindAllDocumentsWand(query, document_predicate, top_documents);
+        }
+        else
+        {
+            FindAllDocuments(query, document_predicate, top_documents);
+        }
+    }
+    else
+    {
+        INSTRUMENT_STAGE(QueryStage::POSTINGS);
+        FindAllDocumentsParallel(query, document_predicate, top_documents);
+    }
+    INSTRUMENT_STAGE(QueryStage::SORT);
+    return top_documents.ExtractSorted();
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocuments(const ResolvedQuery &query, DocumentPredicate document_predicate,
+                                    TopDocuments &top_documents) const
+{
+    ScoreAccumulator &document_to_relevance = ScoreAccumulator::ForCurrentThread();
+    {
+        INSTRUMENT_STAGE(QueryStage::POSTINGS);
+        document_to_relevance.Reset(documents_.size());
+        const auto add_score = [&](int ordinal, double score)
+        {
+            const auto &document_data = documents_[ordinal];
+            if (!IsRemoved(ordinal) && document_predicate(document_data.id, document_data.status, document_data.rating))
             {
-                continue;
+                document_to_relevance.Add(ordinal, score);
             }
-            const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-            for (const auto [document_id, term_freq] : word_to_document_freqs_.find(word)->second)
+            else
             {
-                const auto &document_data = documents_.at(document_id);
-                if (document_predicate(document_id, document_data.status, document_data.rating))
-                {
-                    document_to_relevance[document_id] += term_freq * inverse_document_freq;
-                }
+                INSTRUMENT_COUNT(QueryCounter::POSTINGS_FILTERED_OUT, 1);
             }
-        }
-        for (const std::string_view word : query.minus_words)
+        };
+        for (const auto &[postings, inverse_document_freq] : query.plus_postings)
         {
-            if (word_to_document_freqs_.count(word) == 0)
+            INSTRUMENT_COUNT(QueryCounter::POSTINGS_SCANNED, postings->size());
+            if (const ImpactList *impacts = FindImpacts(*postings))
             {
+                impacts->ForEachImpact(add_score);
                 continue;
             }
-            for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second)
-            {
-                document_to_relevance.erase(document_id);
-            }
+            postings->ForEachPosting([&add_score, inverse_document_freq = inverse_document_freq](int ordinal, double term_freq)
+                                     { add_score(ordinal, term_freq * inverse_document_freq); });
         }
+    }
+    {
+        INSTRUMENT_STAGE(QueryStage::MINUS_WORDS);
+        for (const PostingList *postings : query.minus_postings)
+        {
+            INSTRUMENT_COUNT(QueryCounter::POSTINGS_EXCLUDED, postings->size());
+            postings->ForEachPosting([&document_to_relevance](int ordinal, double)
+                                     { document_to_relevance.Exclude(ordinal); });
+        }
+    }
+
+    INSTRUMENT_STAGE(QueryStage::TOP_K);
+    document_to_relevance.ForEachScore([this, &top_documents](int ordinal, double relevance)
+                                       {
+                                           INSTRUMENT_COUNT(QueryCounter::DOCUMENTS_RANKED, 1);
+                                           const auto &document_data = documents_[ordinal];
+                                           top_documents.Push({document_data.id, relevance, document_data.rating}); });
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocumentsWand(const ResolvedQuery &query, DocumentPredicate document_predicate,
+                                        TopDocuments &top_documents) const
+{
+    struct Cursor
+    {
+        PostingList::Cursor postings;
+        double inverse_document_freq;
+        // Upper bound of the word's contribution to any document
+        double max_score;
+    };
 
-        std::vector<Document> matched_documents;
-        for (const auto [document_id, relevance] : document_to_relevance)
+    QueryArena &arena = QueryArena::ForCurrentThread();
+    QueryArena::Scope scope(arena);
+    // Kept in plus word order, so relevance is summed exactly as in FindAllDocuments
+    std::pmr::vector<Cursor> cursors(&arena);
+    cursors.reserve(query.plus_postings.size());
+    for (const auto &[postings, inverse_document_freq] : query.plus_postings)
+    {
+        cursors.push_back({PostingList::Cursor(*postings), inverse_document_freq, postings->GetMaxTermFreq() * inverse_document_freq});
+    }
+    std::pmr::vector<PostingList::Cursor> minus_cursors(&arena);
+    minus_cursors.reserve(query.minus_postings.size());
+    for (const PostingList *postings : query.minus_postings)
+    {
+        minus_cursors.emplace_back(*postings);
+    }
+    const auto is_excluded = [&minus_cursors](int ordinal)
+    {
+        bool excluded = false;
+        for (PostingList::Cursor &cursor : minus_cursors)
         {
-            matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
+            cursor.Seek(ordinal);
+            excluded = excluded || cursor.GetOrdinal() == ordinal;
         }
-        return matched_documents;
+        return excluded;
+    };
+
+    std::pmr::vector<Cursor *> order(&arena);
+    order.reserve(cursors.size());
+    for (Cursor &cursor : cursors)
+    {
+        order.push_back(&cursor);
     }
-    else
+    while (true)
     {
-        ConcurrentMap<int, double> document_to_relevance_concurent(10);
-        std::vector<std::string_view> plus_words(query.plus_words.begin(), query.plus_words.end());
-        std::vector<std::string_view> minus_words(query.minus_words.begin(), query.minus_words.end());
+        // Only a few cursors move per step, so insertion sort restores the order cheaply
+        for (size_t i = 1; i < order.size(); ++i)
+        {
+            for (size_t j = i; j > 0 && order[j]->postings.GetOrdinal() < order[j - 1]->postings.GetOrdinal(); --j)
+            {
+                std::swap(order[j], order[j - 1]);
+            }
+        }
+
+        // A document scoring below this is ranked under every kept document. The
+        // second DEVIATION absorbs rounding differences between bounds and sums
+        const double threshold = top_documents.IsFull()
+                                     ? top_documents.GetLowest().relevance - 2 * DEVIATION
+                                     : -std::numeric_limits<double>::infinity();
+
+        // Pivot: the first cursor at which the summed upper bounds reach the threshold.
+        // No document before the pivot's ordinal can enter the top
+        size_t pivot = order.size();
+        double bound = 0.0;
+        for (size_t i = 0; i < order.size() && !order[i]->postings.IsAtEnd(); ++i)
+        {
+            bound += order[i]->max_score;
+            if (bound >= threshold)
+            {
+                pivot = i;
+                break;
+            }
+        }
+        if (pivot == order.size())
+        {
+            break;
+        }
+        const int pivot_ordinal = order[pivot]->postings.GetOrdinal();
 
-        for_each(std::execution::par, plus_words.begin(), plus_words.end(), [this, &document_to_relevance_concurent, &document_predicate](const auto word)
-                 {
-        if (word_to_document_freqs_.count(word) == 0)
+        if (order[0]->postings.GetOrdinal() != pivot_ordinal)
+        {
+            for (size_t i = 0; order[i]->postings.GetOrdinal() < pivot_ordinal; ++i)
+            {
+                order[i]->postings.Seek(pivot_ordinal);
+            }
+            continue;
+        }
+
+        size_t last = pivot;
+        while (last + 1 < order.size() && order[last + 1]->postings.GetOrdinal() == pivot_ordinal)
+        {
+            ++last;
+        }
+        // Until the end of the current blocks only these cursors contribute,
+        // and each by no more than its block maximum
+        double block_bound = 0.0;
+        int next_ordinal = last + 1 < order.size() ? order[last + 1]->postings.GetOrdinal() : INT_MAX;
+        for (size_t i = 0; i <= last; ++i)
         {
-            return;
+            block_bound += order[i]->postings.GetBlockMaxTermFreq() * order[i]->inverse_document_freq;
+            next_ordinal = std::min(next_ordinal, order[i]->postings.GetBlockLastOrdinal() + 1);
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.find(word)->second)
+        if (block_bound < threshold)
         {
-            const auto &document_data = documents_.at(document_id);
-            if (document_predicate(document_id, document_data.status, document_data.rating))
+            for (size_t i = 0; i <= last; ++i)
             {
-                document_to_relevance_concurent[document_id].ref_to_value += term_freq * inverse_document_freq;
+                order[i]->postings.Seek(next_ordinal);
             }
-        } });
+            continue;
+        }
 
-        for_each(std::execution::par, minus_words.begin(), minus_words.end(), [this, &document_to_relevance_concurent](const auto word)
-                 {
-        if (word_to_document_freqs_.count(word) == 0)
+        const auto &document_data = documents_[pivot_ordinal];
+        if (!IsRemoved(pivot_ordinal) && !is_excluded(pivot_ordinal) && document_predicate(document_data.id, document_data.status, document_data.rating))
         {
-            return;
+            double relevance = 0.0;
+            for (const Cursor &cursor : cursors)
+            {
+                if (cursor.postings.GetOrdinal() == pivot_ordinal)
+                {
+                    relevance += cursor.postings.GetTermFreq() * cursor.inverse_document_freq;
+                }
+            }
+            top_documents.Push({document_data.id, relevance, document_data.rating});
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.find(word)->second)
+        for (size_t i = 0; i <= last; ++i)
         {
-            document_to_relevance_concurent.erase(document_id);
-        } });
+            order[i]->postings.Next();
+        }
+    }
+}
+
+template <typename DocumentPredicate>
+void SearchServer::FindAllDocumentsParallel(const ResolvedQuery &query, DocumentPredicate document_predicate,
+                                            TopDocuments &top_documents) const
+{
+    // Slices smaller than this cost more to schedule than to score
+    const size_t min_slice_size = 4096;
+    const size_t ordinal_count = documents_.size();
+    const size_t slice_count = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency() * 4,
+                                                                    ordinal_count / min_slice_size));
+    const size_t slice_size = (ordinal_count + slice_count - 1) / slice_count;
 
-        std::map<int, double> document_to_relevance = document_to_relevance_concurent.BuildOrdinaryMap();
-        std::vector<Document> matched_documents(document_to_relevance.size());
-        for (const auto [document_id, relevance] : document_to_relevance)
+    // Copies of the still empty top, so slices keep the same documents
+    std::vector<TopDocuments> slice_tops(slice_count, top_documents);
+    std::vector<size_t> slices(slice_count);
+    std::iota(slices.begin(), slices.end(), 0);
+    std::for_each(std::execution::par, slices.begin(), slices.end(), [&](size_t slice)
+                  {
+        const int first = static_cast<int>(std::min(ordinal_count, slice * slice_size));
+        const int last = static_cast<int>(std::min(ordinal_count, slice * slice_size + slice_size));
+        // Scratch is indexed relative to the start of the slice
+        ScoreAccumulator &document_to_relevance = ScoreAccumulator::ForCurrentThread();
+        document_to_relevance.Reset(last - first);
+        const auto add_score = [&](int ordinal, double score)
+        {
+            const auto &document_data = documents_[ordinal];
+            if (!IsRemoved(ordinal) && document_predicate(document_data.id, document_data.status, document_data.rating))
+            {
+                document_to_relevance.Add(ordinal - first, score);
+            }
+        };
+        for (const auto &[postings, inverse_document_freq] : query.plus_postings)
         {
-            matched_documents.push_back(
-                {document_id, relevance, documents_.at(document_id).rating});
+            if (const ImpactList *impacts = FindImpacts(*postings))
+            {
+                impacts->ForEachImpact(first, last, add_score);
+                continue;
+            }
+            postings->ForEachPosting(first, last, [&add_score, inverse_document_freq = inverse_document_freq](int ordinal, double term_freq)
+                                     { add_score(ordinal, term_freq * inverse_document_freq); });
+        }
+        for (const PostingList *postings : query.minus_postings)
+        {
+            postings->ForEachPosting(first, last, [&](int ordinal, double)
+                                     { document_to_relevance.Exclude(ordinal - first); });
         }
-        return matched_documents;
+        document_to_relevance.ForEachScore([&](int local_ordinal, double relevance)
+                                           {
+                                               const auto &document_data = documents_[first + local_ordinal];
+                                               slice_tops[slice].Push({document_data.id, relevance, document_data.rating}); }); });
+
+    for (const TopDocuments &slice_top : slice_tops)
+    {
+        top_documents.Merge(slice_top);
     }
 }
@@ -0,0 +1,307 @@
+#include "segmented_search_server.h"
+#include "string_processing.h"
+
+using namespace std;
+
+SegmentedSearchServer::SegmentStatistics::SegmentStatistics(const SegmentedSearchServer &server)
+    : server_(server)
+{
+}
+
+int SegmentedSearchServer::SegmentStatistics::GetDocumentCount() const
+{
+    return server_.CountDocuments();
+}
+
+size_t SegmentedSearchServer::SegmentStatistics::GetDocumentFreq(string_view word) const
+{
+    size_t document_freq = server_.buffer_->GetDocumentFreq(word);
+    for (const Segment &segment : server_.segments_)
+    {
+        document_freq += segment.index->GetDocumentFreq(word);
+    }
+    if (const auto it = server_.removed_document_freqs_.find(word); it != server_.removed_document_freqs_.end())
+    {
+        document_freq -= it->second;
+    }
+    return document_freq;
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const string &stop_words_text, SegmentOptions options)
+    : SegmentedSearchServer(string_view(stop_words_text), options)
+{
+}
+
+SegmentedSearchServer::SegmentedSearchServer(const string_view stop_words_text, SegmentOptions options)
+    : SegmentedSearchServer(SplitIntoWords(stop_words_text), options)
+{
+}
+
+SegmentedSearchServer::~SegmentedSearchServer()
+{
+    if (merge_thread_.joinable())
+    {
+        {
+            lock_guard lock(merge_request_mutex_);
+            is_stopping_ = true;
+        }
+        merge_requested_.notify_one();
+        merge_thread_.join();
+    }
+}
+
+void SegmentedSearchServer::Start()
+{
+    // Checks the stop words before the merge thread exists
+    buffer_ = CreateIndex();
+    if (!options_.merge_in_background)
+    {
+        return;
+    }
+    merge_thread_ = thread([this]
+                           {
+        unique_lock lock(merge_request_mutex_);
+        while (true)
+        {
+            merge_requested_.wait(lock, [this]
+                                  { return is_merge_requested_ || is_stopping_; });
+            if (is_stopping_)
+            {
+                return;
+            }
+            is_merge_requested_ = false;
+            lock.unlock();
+            MergeWhileTooMany();
+            lock.lock();
+        } });
+}
+
+unique_ptr<SearchServer> SegmentedSearchServer::CreateIndex() const
+{
+    auto index = make_unique<SearchServer>(stop_words_);
+    index->SetTermStatistics(&statistics_);
+    return index;
+}
+
+int SegmentedSearchServer::CountDocuments() const
+{
+    int document_count = buffer_->GetDocumentCount();
+    for (const Segment &segment : segments_)
+    {
+        document_count += segment.index->GetDocumentCount() - static_cast<int>(segment.removed_ids.size());
+    }
+    return document_count;
+}
+
+void SegmentedSearchServer::AddDocument(int document_id, const string &document, DocumentStatus status,
+                                        const vector<int> &ratings)
+{
+    bool are_merges_due = false;
+    {
+        unique_lock lock(mutex_);
+        // The buffer knows only its own documents
+        if (document_segments_.count(document_id) > 0)
+        {
+            throw invalid_argument("Invalid document_id"s);
+        }
+        buffer_->AddDocument(document_id, document, status, ratings);
+        document_segments_.emplace(document_id, buffer_.get());
+        if (static_cast<size_t>(buffer_->GetDocumentCount()) >= options_.max_buffer_documents)
+        {
+            are_merges_due = FlushBuffer();
+        }
+    }
+    if (are_merges_due)
+    {
+        RequestMerges();
+    }
+}
+
+void SegmentedSearchServer::RemoveDocument(int document_id)
+{
+    unique_lock lock(mutex_);
+    const SearchServer *index = document_segments_.at(document_id);
+    if (index == buffer_.get())
+    {
+        buffer_->RemoveDocument(document_id);
+    }
+    else
+    {
+        const auto segment = find_if(segments_.begin(), segments_.end(), [index](const Segment &segment)
+                                     { return segment.index.get() == index; });
+        segment->removed_ids.insert(document_id);
+        for (const auto &[word, term_freq] : index->GetWordFrequencies(document_id))
+        {
+            auto it = removed_document_freqs_.find(word);
+            if (it == removed_document_freqs_.end())
+            {
+                it = removed_document_freqs_.emplace(string(word), 0).first;
+            }
+            ++it->second;
+        }
+    }
+    document_segments_.erase(document_id);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status,
+                                                         size_t max_count) const
+{
+    return FindTopDocuments(
+        raw_query, [status](int, DocumentStatus document_status, int)
+        { return document_status == status; },
+        max_count);
+}
+
+vector<Document> SegmentedSearchServer::FindTopDocuments(const string_view raw_query) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string_view>, DocumentStatus> SegmentedSearchServer::MatchDocument(const string_view raw_query,
+                                                                                int document_id) const
+{
+    shared_lock lock(mutex_);
+    const auto it = document_segments_.find(document_id);
+    // The buffer throws what SearchServer throws for a document it does not hold
+    const SearchServer &index = it == document_segments_.end() ? *buffer_ : *it->second;
+    auto [words, status] = index.MatchDocument(raw_query, document_id);
+    lock_guard words_lock(matched_words_mutex_);
+    for (string_view &word : words)
+    {
+        word = matched_words_[matched_words_.Intern(word)];
+    }
+    return {move(words), status};
+}
+
+void SegmentedSearchServer::Flush()
+{
+    bool are_merges_due = false;
+    {
+        unique_lock lock(mutex_);
+        are_merges_due = FlushBuffer();
+    }
+    if (are_merges_due)
+    {
+        RequestMerges();
+    }
+}
+
+bool SegmentedSearchServer::FlushBuffer()
+{
+    if (buffer_->GetDocumentCount() == 0)
+    {
+        return false;
+    }
+    // The buffer becomes the segment, so document_segments_ still points to it
+    buffer_->CompactIndex();
+    buffer_->SetIndexStorage(options_.segment_storage);
+    buffer_->SetQueryEvaluation(options_.segment_evaluation);
+    segments_.push_back({shared_ptr<const SearchServer>(move(buffer_)), {}});
+    buffer_ = CreateIndex();
+    return segments_.size() > max<size_t>(1, options_.max_segment_count);
+}
+
+void SegmentedSearchServer::RequestMerges()
+{
+    if (!options_.merge_in_background)
+    {
+        MergeWhileTooMany();
+        return;
+    }
+    {
+        lock_guard lock(merge_request_mutex_);
+        is_merge_requested_ = true;
+    }
+    merge_requested_.notify_one();
+}
+
+void SegmentedSearchServer::MergeWhileTooMany()
+{
+    while (GetSegmentCount() > max<size_t>(1, options_.max_segment_count))
+    {
+        MergeSmallest(max<size_t>(2, options_.merge_factor));
+    }
+}
+
+void SegmentedSearchServer::MergeAllSegments()
+{
+    MergeSmallest(segments_.max_size());
+}
+
+void SegmentedSearchServer::MergeSmallest(size_t count)
+{
+    lock_guard merge_lock(merge_mutex_);
+    vector<Segment> inputs;
+    {
+        shared_lock lock(mutex_);
+        if (segments_.size() < 2)
+        {
+            return;
+        }
+        inputs = segments_;
+    }
+    const auto live_count = [](const Segment &segment)
+    {
+        return segment.index->GetDocumentCount() - static_cast<int>(segment.removed_ids.size());
+    };
+    sort(inputs.begin(), inputs.end(), [&live_count](const Segment &lhs, const Segment &rhs)
+         { return live_count(lhs) < live_count(rhs); });
+    inputs.resize(min(count, inputs.size()));
+
+    // Segments never change and only merges drop them, so the inputs are read
+    // without the lock. Documents removed from now on are dealt with below
+    SearchServer merged(stop_words_);
+    for (const Segment &input : inputs)
+    {
+        merged.AddDocumentsFrom(*input.index, input.removed_ids);
+    }
+    merged.SetIndexStorage(options_.segment_storage);
+    merged.SetQueryEvaluation(options_.segment_evaluation);
+    merged.SetTermStatistics(&statistics_);
+    Segment result{make_shared<const SearchServer>(move(merged)), {}};
+
+    unique_lock lock(mutex_);
+    for (const Segment &input : inputs)
+    {
+        const auto segment = find_if(segments_.begin(), segments_.end(), [&input](const Segment &segment)
+                                     { return segment.index == input.index; });
+        // Documents removed during the merge are in the merged segment
+        set_difference(segment->removed_ids.begin(), segment->removed_ids.end(),
+                       input.removed_ids.begin(), input.removed_ids.end(),
+                       inserter(result.removed_ids, result.removed_ids.end()));
+        // The others are gone for good
+        for (const int document_id : input.removed_ids)
+        {
+            for (const auto &[word, term_freq] : input.index->GetWordFrequencies(document_id))
+            {
+                const auto it = removed_document_freqs_.find(word);
+                if (--it->second == 0)
+                {
+                    removed_document_freqs_.erase(it);
+                }
+            }
+        }
+        segments_.erase(segment);
+    }
+    for (const int document_id : *result.index)
+    {
+        if (const auto it = document_segments_.find(document_id);
+            it != document_segments_.end() && result.removed_ids.count(document_id) == 0)
+        {
+            it->second = result.index.get();
+        }
+    }
+    segments_.push_back(move(result));
+}
+
+int SegmentedSearchServer::GetDocumentCount() const
+{
+    shared_lock lock(mutex_);
+    return CountDocuments();
+}
+
+size_t SegmentedSearchServer::GetSegmentCount() const
+{
+    shared_lock lock(mutex_);
+    return segments_.size();
+}
@@ -0,0 +1,232 @@
+#pragma once
+#include "search_server.h"
+#include "term_dictionary.h"
+#include "term_statistics.h"
+#include "top_documents.h"
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <execution>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <set>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+struct SegmentOptions
+{
+    // AddDocument flushes the write buffer into a segment once it holds this
+    // many documents
+    size_t max_buffer_documents = 10000;
+    // Having more segments than this triggers merges of the smallest ones
+    size_t max_segment_count = 8;
+    // Segments merged into one at a time, at least two
+    size_t merge_factor = 4;
+    // Layout of flushed and merged segments, which never change
+    IndexStorage segment_storage = IndexStorage::COMPRESSED;
+    QueryEvaluation segment_evaluation = QueryEvaluation::WAND;
+    // Merges run on a thread of their own; otherwise the call that flushed
+    // the buffer runs them
+    bool merge_in_background = true;
+};
+
+// Log-structured SearchServer. New documents go to a small mutable write
+// buffer, which is flushed into an immutable segment once full; whenever
+// there are too many segments, the smallest ones are merged into one. Adding
+// a document then costs the same however large the index grows, and segments
+// use read-optimized layouts, see SegmentOptions.
+//
+// Searches run on the buffer and all segments in parallel and merge the
+// per-segment tops. Inverse document frequencies are computed from the counts
+// of all of them, so results are those of a single SearchServer holding every
+// document; with IndexStorage::COMPRESSED segments, to within the
+// quantization error. Removing a document of a segment only records its id:
+// searches skip it and the next merge of the segment leaves it out.
+//
+// Searches may run concurrently with each other, with changes and with
+// merges, which build the merged segment without blocking either
+class SegmentedSearchServer
+{
+public:
+    template <typename StringContainer>
+    explicit SegmentedSearchServer(const StringContainer &stop_words, SegmentOptions options = {});
+    explicit SegmentedSearchServer(const std::string &stop_words_text, SegmentOptions options = {});
+    explicit SegmentedSearchServer(const std::string_view stop_words_text, SegmentOptions options = {});
+
+    // Segments refer to the statistics of the server they belong to
+    SegmentedSearchServer(const SegmentedSearchServer &) = delete;
+    SegmentedSearchServer &operator=(const SegmentedSearchServer &) = delete;
+    // Waits for a merge in progress
+    ~SegmentedSearchServer();
+
+    void AddDocument(int document_id, const std::string &document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+    void RemoveDocument(int document_id);
+
+    // Each segment searches sequentially with its own QueryEvaluation
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    // Runs on the segment holding the document. Matched words stay valid
+    // while the server is alive, even once that segment is merged
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
+                                                                            int document_id) const;
+
+    // Turns the write buffer into a segment, even if it is not full
+    void Flush();
+    // Merges all segments into one; waits for a merge in progress first
+    void MergeAllSegments();
+
+    int GetDocumentCount() const;
+    // Flushed segments, the write buffer excluded
+    size_t GetSegmentCount() const;
+
+private:
+    struct Segment
+    {
+        std::shared_ptr<const SearchServer> index;
+        // Documents removed since the segment was built
+        std::set<int> removed_ids;
+    };
+
+    // Sums the counts of the buffer and all segments; read under mutex_
+    class SegmentStatistics : public TermStatistics
+    {
+    public:
+        explicit SegmentStatistics(const SegmentedSearchServer &server);
+
+        int GetDocumentCount() const override;
+        size_t GetDocumentFreq(std::string_view word) const override;
+
+    private:
+        const SegmentedSearchServer &server_;
+    };
+
+    const std::vector<std::string> stop_words_;
+    const SegmentOptions options_;
+    SegmentStatistics statistics_;
+
+    // Guards the buffer, the segment list and the maps below. Searches hold
+    // it shared, changes exclusively
+    mutable std::shared_mutex mutex_;
+    std::unique_ptr<SearchServer> buffer_;
+    std::vector<Segment> segments_;
+    // The buffer or segment holding each document that is not removed
+    std::map<int, const SearchServer *> document_segments_;
+    // Removed documents of segments containing each word
+    std::map<std::string, size_t, std::less<>> removed_document_freqs_;
+
+    // Every word MatchDocument has returned. Segments are freed by merges, so
+    // matched words point here rather than into them
+    mutable std::mutex matched_words_mutex_;
+    mutable TermDictionary matched_words_;
+
+    // Held for the whole of a merge, so merges run one at a time
+    std::mutex merge_mutex_;
+    std::thread merge_thread_;
+    std::mutex merge_request_mutex_;
+    std::condition_variable merge_requested_;
+    bool is_merge_requested_ = false;
+    bool is_stopping_ = false;
+
+    void Start();
+    std::unique_ptr<SearchServer> CreateIndex() const;
+    int CountDocuments() const;
+
+    // Returns whether merges are due; mutex_ must be held exclusively
+    bool FlushBuffer();
+    // Merges are run or handed to the merge thread
+    void RequestMerges();
+    void MergeWhileTooMany();
+    // Merges up to count of the smallest segments into one
+    void MergeSmallest(size_t count);
+
+    template <typename Search>
+    std::vector<Document> SearchSegments(Search search, size_t max_count) const;
+};
+
+template <typename StringContainer>
+SegmentedSearchServer::SegmentedSearchServer(const StringContainer &stop_words, SegmentOptions options)
+    : stop_words_(std::begin(stop_words), std::end(stop_words))
+    , options_(options)
+    , statistics_(*this)
+{
+    Start();
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> SegmentedSearchServer::FindTopDocuments(const std::string_view raw_query,
+                                                              DocumentPredicate document_predicate,
+                                                              size_t max_count) const
+{
+    return SearchSegments([&](const SearchServer &index, const std::set<int> &removed_ids)
+                          {
+                              if (removed_ids.empty())
+                              {
+                                  return index.FindTopDocuments(raw_query, document_predicate, max_count);
+                              }
+                              return index.FindTopDocuments(
+                                  raw_query, [&](int document_id, DocumentStatus status, int rating)
+                                  { return removed_ids.count(document_id) == 0 && document_predicate(document_id, status, rating); },
+                                  max_count); },
+                          max_count);
+}
+
+template <typename Search>
+std::vector<Document> SegmentedSearchServer::SearchSegments(Search search, size_t max_count) const
+{
+    static const std::set<int> no_removed_ids;
+    std::shared_lock lock(mutex_);
+    std::vector<std::pair<const SearchServer *, const std::set<int> *>> indexes;
+    indexes.reserve(segments_.size() + 1);
+    indexes.emplace_back(buffer_.get(), &no_removed_ids);
+    for (const Segment &segment : segments_)
+    {
+        indexes.emplace_back(segment.index.get(), &segment.removed_ids);
+    }
+
+    std::vector<std::vector<Document>> segment_tops(indexes.size());
+    std::vector<std::exception_ptr> errors(indexes.size());
+    std::vector<size_t> segment_indexes(indexes.size());
+    std::iota(segment_indexes.begin(), segment_indexes.end(), 0);
+    std::for_each(std::execution::par, segment_indexes.begin(), segment_indexes.end(), [&](size_t i)
+                  {
+                      try
+                      {
+                          segment_tops[i] = search(*indexes[i].first, *indexes[i].second);
+                      }
+                      catch (...)
+                      {
+                          errors[i] = std::current_exception();
+                      } });
+    // Every segment parses the query, so all of them fail the same way
+    for (const std::exception_ptr &error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    TopDocuments top_documents(max_count);
+    for (const std::vector<Document> &segment_top : segment_tops)
+    {
+        for (const Document &document : segment_top)
+        {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.ExtractSorted();
+}
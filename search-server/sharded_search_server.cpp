@@ -0,0 +1,128 @@
+#include "sharded_search_server.h"
+
+using namespace std;
+
+ShardedSearchServer::ShardStatistics::ShardStatistics(const vector<SearchServer> &shards)
+    : shards_(shards)
+{
+}
+
+int ShardedSearchServer::ShardStatistics::GetDocumentCount() const
+{
+    int document_count = 0;
+    for (const SearchServer &shard : shards_)
+    {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::ShardStatistics::GetDocumentFreq(string_view word) const
+{
+    size_t document_freq = 0;
+    for (const SearchServer &shard : shards_)
+    {
+        document_freq += shard.GetDocumentFreq(word);
+    }
+    return document_freq;
+}
+
+ShardedSearchServer::ShardedSearchServer(const string &stop_words_text, size_t shard_count)
+    : ShardedSearchServer(string_view(stop_words_text), shard_count)
+{
+}
+
+ShardedSearchServer::ShardedSearchServer(const string_view stop_words_text, size_t shard_count)
+    : statistics_(shards_)
+{
+    CreateShards(stop_words_text, shard_count);
+}
+
+void ShardedSearchServer::AddDocument(int document_id, const string &document, DocumentStatus status,
+                                      const vector<int> &ratings)
+{
+    shards_[GetShardIndex(document_id)].AddDocument(document_id, document, status, ratings);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id)
+{
+    shards_[GetShardIndex(document_id)].RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(execution::sequenced_policy policy, int document_id)
+{
+    shards_[GetShardIndex(document_id)].RemoveDocument(policy, document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(execution::parallel_policy policy, int document_id)
+{
+    shards_[GetShardIndex(document_id)].RemoveDocument(policy, document_id);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query, DocumentStatus status,
+                                                       size_t max_count) const
+{
+    return SearchShards([&](const SearchServer &shard)
+                        { return shard.FindTopDocuments(raw_query, status, max_count); },
+                        max_count);
+}
+
+vector<Document> ShardedSearchServer::FindTopDocuments(const string_view raw_query) const
+{
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(const string_view raw_query,
+                                                                              int document_id) const
+{
+    return shards_[GetShardIndex(document_id)].MatchDocument(raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(execution::sequenced_policy policy, const string_view raw_query,
+                                                                              int document_id) const
+{
+    return shards_[GetShardIndex(document_id)].MatchDocument(policy, raw_query, document_id);
+}
+
+tuple<vector<string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(execution::parallel_policy policy, const string_view raw_query,
+                                                                              int document_id) const
+{
+    return shards_[GetShardIndex(document_id)].MatchDocument(policy, raw_query, document_id);
+}
+
+void ShardedSearchServer::SetIndexStorage(IndexStorage index_storage)
+{
+    for (SearchServer &shard : shards_)
+    {
+        shard.SetIndexStorage(index_storage);
+    }
+}
+
+void ShardedSearchServer::SetQueryEvaluation(QueryEvaluation query_evaluation)
+{
+    for (SearchServer &shard : shards_)
+    {
+        shard.SetQueryEvaluation(query_evaluation);
+    }
+}
+
+int ShardedSearchServer::GetDocumentCount() const
+{
+    return statistics_.GetDocumentCount();
+}
+
+size_t ShardedSearchServer::GetShardCount() const
+{
+    return shards_.size();
+}
+
+const SearchServer &ShardedSearchServer::GetShard(size_t shard) const
+{
+    return shards_.at(shard);
+}
+
+size_t ShardedSearchServer::GetShardIndex(int document_id) const
+{
+    // Negative ids land on some shard, which rejects them like SearchServer does
+    return static_cast<unsigned>(document_id) % shards_.size();
+}
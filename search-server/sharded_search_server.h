@@ -0,0 +1,162 @@
+#pragma once
+#include "search_server.h"
+#include "term_statistics.h"
+#include "top_documents.h"
+#include <algorithm>
+#include <exception>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+// SearchServer split into shards by document id. Every shard is a SearchServer
+// holding the documents with id % shard_count equal to its number; searches
+// run on all shards in parallel and the per-shard tops are merged.
+//
+// Shards compute inverse document frequencies from the counts of all shards,
+// summed on every search, so relevance and ranking are exactly those of a
+// single server holding every document. With IndexStorage::COMPRESSED they
+// agree to within the quantization error, which depends on how postings fall
+// into blocks. Like SearchServer, the server is not safe to change while it
+// is searched
+class ShardedSearchServer
+{
+public:
+    template <typename StringContainer>
+    ShardedSearchServer(const StringContainer &stop_words, size_t shard_count);
+    ShardedSearchServer(const std::string &stop_words_text, size_t shard_count);
+    ShardedSearchServer(const std::string_view stop_words_text, size_t shard_count);
+
+    // Shards refer to the statistics of the server they belong to
+    ShardedSearchServer(const ShardedSearchServer &) = delete;
+    ShardedSearchServer &operator=(const ShardedSearchServer &) = delete;
+
+    void AddDocument(int document_id, const std::string &document, DocumentStatus status,
+                     const std::vector<int> &ratings);
+    void RemoveDocument(int document_id);
+    void RemoveDocument(std::execution::sequenced_policy policy, int document_id);
+    void RemoveDocument(std::execution::parallel_policy policy, int document_id);
+
+    // Each shard searches sequentially, so QueryEvaluation::WAND applies
+    template <typename DocumentPredicate>
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentPredicate document_predicate,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query, DocumentStatus status,
+                                           size_t max_count = MAX_RESULT_DOCUMENT_COUNT) const;
+    std::vector<Document> FindTopDocuments(const std::string_view raw_query) const;
+
+    // Runs on the shard holding the document
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view raw_query,
+                                                                            int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::sequenced_policy policy, const std::string_view raw_query,
+                                                                            int document_id) const;
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::execution::parallel_policy policy, const std::string_view raw_query,
+                                                                            int document_id) const;
+
+    void SetIndexStorage(IndexStorage index_storage);
+    void SetQueryEvaluation(QueryEvaluation query_evaluation);
+
+    int GetDocumentCount() const;
+    size_t GetShardCount() const;
+    const SearchServer &GetShard(size_t shard) const;
+    size_t GetShardIndex(int document_id) const;
+
+private:
+    // Sums the counts of all shards
+    class ShardStatistics : public TermStatistics
+    {
+    public:
+        explicit ShardStatistics(const std::vector<SearchServer> &shards);
+
+        int GetDocumentCount() const override;
+        size_t GetDocumentFreq(std::string_view word) const override;
+
+    private:
+        const std::vector<SearchServer> &shards_;
+    };
+
+    std::vector<SearchServer> shards_;
+    ShardStatistics statistics_;
+
+    template <typename StopWords>
+    void CreateShards(const StopWords &stop_words, size_t shard_count);
+
+    template <typename Search>
+    std::vector<Document> SearchShards(Search search, size_t max_count) const;
+};
+
+template <typename StringContainer>
+ShardedSearchServer::ShardedSearchServer(const StringContainer &stop_words, size_t shard_count)
+    : statistics_(shards_)
+{
+    CreateShards(stop_words, shard_count);
+}
+
+template <typename StopWords>
+void ShardedSearchServer::CreateShards(const StopWords &stop_words, size_t shard_count)
+{
+    if (shard_count == 0)
+    {
+        throw std::invalid_argument("Shard count must be positive");
+    }
+    // Shards must not move once they refer to the statistics
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i)
+    {
+        shards_.emplace_back(stop_words);
+    }
+    for (SearchServer &shard : shards_)
+    {
+        shard.SetTermStatistics(&statistics_);
+    }
+}
+
+template <typename DocumentPredicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(const std::string_view raw_query,
+                                                            DocumentPredicate document_predicate,
+                                                            size_t max_count) const
+{
+    return SearchShards([&](const SearchServer &shard)
+                        { return shard.FindTopDocuments(raw_query, document_predicate, max_count); },
+                        max_count);
+}
+
+template <typename Search>
+std::vector<Document> ShardedSearchServer::SearchShards(Search search, size_t max_count) const
+{
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::vector<std::vector<Document>> shard_tops(shards_.size());
+    std::vector<std::exception_ptr> errors(shards_.size());
+    std::for_each(std::execution::par, shard_indexes.begin(), shard_indexes.end(), [&](size_t shard)
+                  {
+                      try
+                      {
+                          shard_tops[shard] = search(shards_[shard]);
+                      }
+                      catch (...)
+                      {
+                          errors[shard] = std::current_exception();
+                      } });
+    // Every shard parses the query, so all of them fail the same way
+    for (const std::exception_ptr &error : errors)
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    TopDocuments top_documents(max_count);
+    for (const std::vector<Document> &shard_top : shard_tops)
+    {
+        for (const Document &document : shard_top)
+        {
+            top_documents.Push(document);
+        }
+    }
+    return top_documents.ExtractSorted();
+}
@@ -1,22 +1,147 @@
 #include "string_processing.h"
 #include <algorithm>
+#include <cstdint>
+#include <memory_resource>
 #include <set>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 using namespace std;
 
-vector<string_view> SplitIntoWords(string_view text) {
-    vector<string_view> words;
+namespace {
 
-    text.remove_prefix(min(text.find_first_not_of(' '), text.size()));
-    while(!text.empty()){
-        auto word_end = text.find(' ');
-        auto word = text.substr(0, word_end);
-        words.push_back(word);
-        text.remove_prefix(word.size());
-        text.remove_prefix(min(text.find_first_not_of(' '), text.size()));
+// Bytes scanned at once; bit i of a mask describes byte i of the block
+constexpr size_t SCAN_BLOCK_SIZE = 32;
+
+struct BlockMasks {
+    uint32_t spaces;
+    uint32_t controls;
+};
+
+BlockMasks ScanTail(const char* data, size_t size) {
+    // Bytes past the end count as spaces, so the last word ends at the end of text
+    BlockMasks masks{~0u, 0u};
+    for (size_t i = 0; i < size; ++i) {
+        const auto c = static_cast<unsigned char>(data[i]);
+        if (c != ' ') {
+            masks.spaces &= ~(1u << i);
+        }
+        if (c < ' ') {
+            masks.controls |= 1u << i;
+        }
     }
+    return masks;
+}
+
+#if defined(__AVX2__)
+BlockMasks ScanBlock(const char* data) {
+    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    const __m256i spaces = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(' '));
+    // Signed comparisons: control characters are the bytes in [0, ' ')
+    const __m256i controls = _mm256_and_si256(_mm256_cmpgt_epi8(bytes, _mm256_set1_epi8(-1)),
+                                              _mm256_cmpgt_epi8(_mm256_set1_epi8(' '), bytes));
+    return {static_cast<uint32_t>(_mm256_movemask_epi8(spaces)),
+            static_cast<uint32_t>(_mm256_movemask_epi8(controls))};
+}
+#elif defined(__SSE2__)
+BlockMasks ScanBlock(const char* data) {
+    BlockMasks masks{0u, 0u};
+    for (size_t half = 0; half < 2; ++half) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16 * half));
+        const __m128i spaces = _mm_cmpeq_epi8(bytes, _mm_set1_epi8(' '));
+        // Signed comparisons: control characters are the bytes in [0, ' ')
+        const __m128i controls = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8(-1)),
+                                               _mm_cmplt_epi8(bytes, _mm_set1_epi8(' ')));
+        masks.spaces |= static_cast<uint32_t>(_mm_movemask_epi8(spaces)) << (16 * half);
+        masks.controls |= static_cast<uint32_t>(_mm_movemask_epi8(controls)) << (16 * half);
+    }
+    return masks;
+}
+#else
+BlockMasks ScanBlock(const char* data) {
+    return ScanTail(data, SCAN_BLOCK_SIZE);
+}
+#endif
+
+int CountTrailingZeros(uint32_t mask) {
+#if defined(__GNUC__)
+    return __builtin_ctz(mask);
+#else
+    int count = 0;
+    while ((mask & 1u) == 0) {
+        mask >>= 1;
+        ++count;
+    }
+    return count;
+#endif
+}
+
+template <typename Words>
+size_t AppendWords(string_view text, Words& words) {
+    const size_t first_word = words.size();
+    const char* const data = text.data();
+    const size_t size = text.size();
+    size_t first_control = size;
+    size_t word_begin = size;
+    bool in_word = false;
+    // Whether the byte before the block is a space; text is preceded by one
+    uint32_t previous_space = 1;
+
+    for (size_t block = 0; block < size; block += SCAN_BLOCK_SIZE) {
+        const size_t block_size = min(SCAN_BLOCK_SIZE, size - block);
+        const BlockMasks masks = block_size == SCAN_BLOCK_SIZE ? ScanBlock(data + block)
+                                                               : ScanTail(data + block, block_size);
+        if (masks.controls != 0 && first_control == size) {
+            first_control = block + CountTrailingZeros(masks.controls);
+        }
+        // A bit is set where a word begins or ends
+        uint32_t boundaries = masks.spaces ^ ((masks.spaces << 1) | previous_space);
+        previous_space = masks.spaces >> (SCAN_BLOCK_SIZE - 1);
+        while (boundaries != 0) {
+            const size_t position = block + CountTrailingZeros(boundaries);
+            if (in_word) {
+                words.emplace_back(data + word_begin, position - word_begin);
+            } else {
+                word_begin = position;
+            }
+            in_word = !in_word;
+            boundaries &= boundaries - 1;
+        }
+    }
+    if (in_word) {
+        words.emplace_back(data + word_begin, size - word_begin);
+    }
+
+    if (first_control == size) {
+        return words.size();
+    }
+    // A control character is not a space, so it lies inside some word
+    const auto word = upper_bound(words.begin() + first_word, words.end(), data + first_control,
+                                  [](const char* position, string_view word) {
+                                      return position < word.data();
+                                  });
+    return static_cast<size_t>(word - words.begin()) - 1;
+}
+
+}  // namespace
+
+size_t SplitIntoWords(string_view text, vector<string_view>& words) {
+    return AppendWords(text, words);
+}
+
+size_t SplitIntoWords(string_view text, pmr::vector<string_view>& words) {
+    return AppendWords(text, words);
+}
+
+vector<string_view> SplitIntoWords(string_view text) {
+    vector<string_view> words;
+    SplitIntoWords(text, words);
     return words;
-}
\ No newline at end of file
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstddef>
+#include <memory_resource>
 #include <set>
 #include <string>
 #include <string_view>
@@ -6,6 +8,13 @@
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Appends the space-separated words of text to words, so one buffer can be reused
+// across texts. Control characters (below ' ') are looked for in the same pass:
+// returns the index in words of the first word containing one, or words.size()
+// if there is none. Scans 32 bytes at a time with AVX2 or SSE2 when available.
+size_t SplitIntoWords(std::string_view text, std::vector<std::string_view>& words);
+size_t SplitIntoWords(std::string_view text, std::pmr::vector<std::string_view>& words);
+
 template <typename StringContainer>
 std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
     std::set<std::string, std::less<>> non_empty_strings;
@@ -0,0 +1,100 @@
+#include "term_dictionary.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    : chunks_(other.chunks_)
+    , chunk_bytes_(other.chunk_bytes_)
+    , terms_(other.terms_)
+    , term_ids_(other.term_ids_)
+    , sorted_term_count_(other.sorted_term_count_) {
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        *this = TermDictionary(other);
+    }
+    return *this;
+}
+
+size_t TermDictionary::Intern(string_view term) {
+    if (sorted_term_count_ > 0) {
+        // A new term would break the order, so switch to hashing
+        term_ids_.reserve(terms_.size());
+        for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+            term_ids_.emplace(terms_[term_id], term_id);
+        }
+        sorted_term_count_ = 0;
+    }
+    if (const auto it = term_ids_.find(term); it != term_ids_.end()) {
+        return it->second;
+    }
+    const size_t term_id = terms_.size();
+    terms_.push_back(Store(term));
+    term_ids_.emplace(terms_.back(), term_id);
+    return term_id;
+}
+
+size_t TermDictionary::Find(string_view term) const {
+    if (sorted_term_count_ > 0) {
+        const auto last = terms_.begin() + sorted_term_count_;
+        const auto it = lower_bound(terms_.begin(), last, term);
+        return it != last && *it == term ? it - terms_.begin() : terms_.size();
+    }
+    const auto it = term_ids_.find(term);
+    return it == term_ids_.end() ? terms_.size() : it->second;
+}
+
+void TermDictionary::AssignSorted(vector<string_view> terms) {
+    *this = TermDictionary();
+    terms_ = move(terms);
+    sorted_term_count_ = terms_.size();
+}
+
+void TermDictionary::Retain(const vector<bool>& keep) {
+    size_t kept = 0;
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        if (keep[term_id]) {
+            terms_[kept++] = terms_[term_id];
+        }
+    }
+    terms_.resize(kept);
+    if (sorted_term_count_ > 0) {
+        // Dropping terms keeps the rest sorted
+        sorted_term_count_ = kept;
+        return;
+    }
+    term_ids_.clear();
+    for (size_t term_id = 0; term_id < terms_.size(); ++term_id) {
+        term_ids_.emplace(terms_[term_id], term_id);
+    }
+}
+
+size_t TermDictionary::GetMemoryUsage() const {
+    // Hash nodes hold a key, a value and a next pointer
+    return chunk_bytes_ + terms_.capacity() * sizeof(string_view)
+           + term_ids_.bucket_count() * sizeof(void*)
+           + term_ids_.size() * (sizeof(pair<const string_view, size_t>) + sizeof(void*));
+}
+
+string_view TermDictionary::Store(string_view term) {
+    if (term.size() > CHUNK_SIZE / 4) {
+        // Long terms get chunks of their own, so little of a shared chunk is wasted
+        chunks_.emplace_back(new char[term.size()]);
+        chunk_bytes_ += term.size();
+        last_chunk_free_ = 0;
+        memcpy(chunks_.back().get(), term.data(), term.size());
+        return {chunks_.back().get(), term.size()};
+    }
+    if (chunks_.empty() || last_chunk_free_ < term.size()) {
+        chunks_.emplace_back(new char[CHUNK_SIZE]);
+        chunk_bytes_ += CHUNK_SIZE;
+        last_chunk_free_ = CHUNK_SIZE;
+    }
+    char* data = chunks_.back().get() + CHUNK_SIZE - last_chunk_free_;
+    memcpy(data, term.data(), term.size());
+    last_chunk_free_ -= term.size();
+    return {data, term.size()};
+}
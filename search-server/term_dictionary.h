@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Term dictionary: every distinct term is stored once and gets a dense id.
+// Texts are copied back to back into large chunks rather than into a string
+// per term. Chunks are shared by copies of the dictionary and never change
+// once written, so the string_views it hands out stay valid while any copy is
+// alive.
+class TermDictionary {
+public:
+    TermDictionary() = default;
+    // The copy shares the chunks but stores its own new terms in new ones
+    TermDictionary(const TermDictionary& other);
+    TermDictionary& operator=(const TermDictionary& other);
+    TermDictionary(TermDictionary&&) = default;
+    TermDictionary& operator=(TermDictionary&&) = default;
+
+    // Returns the id of the term, adding it if needed
+    size_t Intern(std::string_view term);
+    // Returns size() if the term is not in the dictionary
+    size_t Find(std::string_view term) const;
+
+    std::string_view operator[](size_t term_id) const {
+        return terms_[term_id];
+    }
+    size_t size() const {
+        return terms_.size();
+    }
+
+    // Replaces the dictionary with sorted terms stored elsewhere, which must
+    // outlive it and its copies. Term ids are positions in terms. The terms are
+    // found by binary search until the first new term is interned
+    void AssignSorted(std::vector<std::string_view> terms);
+
+    // Drops the terms whose keep flag is false and renumbers the rest in their
+    // order. Texts stay in their chunks, so string_views handed out earlier
+    // stay valid; the space of dropped texts is not reused
+    void Retain(const std::vector<bool>& keep);
+
+    // Heap bytes held, excluding the object itself
+    size_t GetMemoryUsage() const;
+
+private:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    std::vector<std::shared_ptr<char[]>> chunks_;
+    size_t chunk_bytes_ = 0;
+    // Unused bytes at the end of the last chunk
+    size_t last_chunk_free_ = 0;
+    std::vector<std::string_view> terms_;
+    std::unordered_map<std::string_view, size_t> term_ids_;
+    // Terms given to AssignSorted that are not in term_ids_ yet
+    size_t sorted_term_count_ = 0;
+
+    std::string_view Store(std::string_view term);
+};
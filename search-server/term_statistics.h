@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <string_view>
+
+// Corpus-wide counts that inverse document frequencies are computed from. A
+// SearchServer counts its own index unless it is given another source, so
+// that servers holding parts of one corpus rank like a single server over all
+// of it
+class TermStatistics {
+public:
+    virtual ~TermStatistics() = default;
+
+    virtual int GetDocumentCount() const = 0;
+    // Number of documents containing the word
+    virtual size_t GetDocumentFreq(std::string_view word) const = 0;
+};
@@ -0,0 +1,109 @@
+// Impacts are scored with the inverse document frequencies of the time they
+// were built; relevance must stay within the documented bound of the exact one.
+
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+
+#include <cmath>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t ALL_DOCUMENTS = 100000;
+
+// Largest relevance difference over every document matching any query
+double MeasureMaxError(const SearchServer& search_server, const SearchServer& exact, const vector<string>& queries) {
+    double max_error = 0.0;
+    for (const string& query : queries) {
+        map<int, double> exact_relevances;
+        for (const Document& document : exact.FindTopDocuments(query, DocumentStatus::ACTUAL, ALL_DOCUMENTS)) {
+            exact_relevances[document.id] = document.relevance;
+        }
+        const auto documents = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, ALL_DOCUMENTS);
+        ASSERT_EQUAL_HINT(documents.size(), exact_relevances.size(), query);
+        for (const Document& document : documents) {
+            ASSERT_HINT(exact_relevances.count(document.id) == 1, query + ", id "s + to_string(document.id));
+            max_error = max(max_error, abs(document.relevance - exact_relevances.at(document.id)));
+        }
+    }
+    return max_error;
+}
+
+template <typename Change>
+void ChangeBoth(SearchServer& search_server, SearchServer& exact, Change change) {
+    change(search_server);
+    change(exact);
+}
+
+void TestImpactsStayWithinTolerance() {
+    mt19937 generator(31);
+    const vector<string> dictionary = MakeTestDictionary(80);
+    vector<string> queries;
+    for (int i = 0; i < 30; ++i) {
+        queries.push_back(MakeTestText(generator, dictionary, 1 + i % 5, 0.1));
+    }
+    const vector<NewDocument> documents = MakeTestDocuments(generator, dictionary, 1400);
+    for (const double tolerance : {0.0, 0.05, 0.2}) {
+        // Term frequencies of a document sum to at most one
+        const double bound = -log(1.0 - tolerance) + DEVIATION;
+        SearchServer search_server("w3"s);
+        SearchServer exact("w3"s);
+        search_server.SetImpactScoring(ImpactScoring::FLOAT);
+        search_server.SetImpactRefreshTolerance(tolerance);
+        const vector<NewDocument> first(documents.begin(), documents.begin() + 1000);
+        ChangeBoth(search_server, exact, [&first](SearchServer& server) {
+            server.AddDocuments(first);
+        });
+        ASSERT(MeasureMaxError(search_server, exact, queries) <= DEVIATION);
+
+        // Every addition and removal moves the document count, so inverse
+        // document frequencies of words the change does not touch drift
+        const string hint = "tolerance "s + to_string(tolerance);
+        for (size_t i = 1000; i < documents.size(); ++i) {
+            const NewDocument& document = documents[i];
+            ChangeBoth(search_server, exact, [&document](SearchServer& server) {
+                server.AddDocument(document.id, document.text, document.status, document.ratings);
+            });
+            if (i % 40 == 0) {
+                ChangeBoth(search_server, exact, [i](SearchServer& server) {
+                    server.RemoveDocument(static_cast<int>(i / 2));
+                });
+                const double error = MeasureMaxError(search_server, exact, queries);
+                ASSERT_HINT(error <= bound, hint + ", error "s + to_string(error) + " after "s + to_string(i) + " documents"s);
+            }
+        }
+        search_server.RefreshImpacts();
+        ASSERT_HINT(MeasureMaxError(search_server, exact, queries) <= DEVIATION, hint);
+    }
+}
+
+void TestQuantizedImpacts() {
+    mt19937 generator(37);
+    const vector<string> dictionary = MakeTestDictionary(80);
+    SearchServer search_server(""s);
+    SearchServer exact(""s);
+    search_server.SetImpactScoring(ImpactScoring::QUANTIZED);
+    const vector<NewDocument> documents = MakeTestDocuments(generator, dictionary, 1000);
+    search_server.AddDocuments(documents);
+    exact.AddDocuments(documents);
+    vector<string> queries;
+    for (int i = 0; i < 30; ++i) {
+        queries.push_back(MakeTestText(generator, dictionary, 1 + i % 5));
+    }
+    // Each word's impact is off by up to 1e-5 of its largest one, at most ln(1000)
+    ASSERT(MeasureMaxError(search_server, exact, queries) <= 5 * 1e-5 * log(1000.0));
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestImpactsStayWithinTolerance);
+    RUN_TEST(TestQuantizedImpacts);
+    return 0;
+}
@@ -0,0 +1,138 @@
+// A loaded snapshot must answer like the server that saved it, and damaged
+// files must be rejected with std::runtime_error.
+
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+string TempSnapshotPath() {
+    return (filesystem::temp_directory_path() / "search_server_snapshot_test.idx"s).string();
+}
+
+string ReadFile(const string& path) {
+    ifstream in(path, ios::binary);
+    return {istreambuf_iterator<char>(in), istreambuf_iterator<char>()};
+}
+
+void WriteFile(const string& path, const string& bytes) {
+    ofstream out(path, ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+void AssertSameAnswers(const SearchServer& loaded, const SearchServer& saved, const vector<string>& queries,
+                       const string& hint) {
+    ASSERT_EQUAL_HINT(loaded.GetDocumentCount(), saved.GetDocumentCount(), hint);
+    ASSERT_HINT(vector<int>(loaded.begin(), loaded.end()) == vector<int>(saved.begin(), saved.end()), hint);
+    for (const string& query : queries) {
+        for (const DocumentStatus status : {DocumentStatus::ACTUAL, DocumentStatus::IRRELEVANT}) {
+            ASSERT_SAME_DOCUMENTS_HINT(loaded.FindTopDocuments(query, status, 50), saved.FindTopDocuments(query, status, 50),
+                                       0.0, hint + ", query "s + query);
+        }
+        for (const int id : saved) {
+            const auto [saved_words, saved_status] = saved.MatchDocument(query, id);
+            const auto [loaded_words, loaded_status] = loaded.MatchDocument(query, id);
+            ASSERT_HINT(loaded_words == saved_words, hint + ", query "s + query + ", id "s + to_string(id));
+            ASSERT_HINT(loaded_status == saved_status, hint + ", id "s + to_string(id));
+        }
+    }
+}
+
+void TestSnapshotRoundTrip() {
+    mt19937 generator(7);
+    const vector<string> dictionary = MakeTestDictionary(60);
+    vector<string> queries;
+    for (int i = 0; i < 20; ++i) {
+        queries.push_back(MakeTestText(generator, dictionary, 1 + i % 4, 0.2));
+    }
+    const string path = TempSnapshotPath();
+    for (const IndexStorage storage : {IndexStorage::PLAIN, IndexStorage::COMPRESSED}) {
+        for (const DeletionMode deletion_mode : {DeletionMode::IMMEDIATE, DeletionMode::TOMBSTONE}) {
+            const string hint = (storage == IndexStorage::PLAIN ? "plain"s : "compressed"s)
+                                + (deletion_mode == DeletionMode::IMMEDIATE ? ", immediate"s : ", tombstone"s);
+            SearchServer search_server("w1 w5"s);
+            search_server.SetIndexStorage(storage);
+            search_server.SetDeletionMode(deletion_mode);
+            search_server.AddDocuments(MakeTestDocuments(generator, dictionary, 600));
+            for (int id = 0; id < 600; id += 4) {
+                search_server.RemoveDocument(id);
+            }
+            search_server.SaveIndex(path);
+            SearchServer loaded = SearchServer::LoadIndex(path);
+            AssertSameAnswers(loaded, search_server, queries, hint);
+
+            // Changes to a loaded index copy the touched parts off the mapping
+            for (SearchServer* server : {&search_server, &loaded}) {
+                server->AddDocument(1000, "w2 w3 w3 w7"s, DocumentStatus::ACTUAL, {5, -2});
+                server->RemoveDocument(1);
+                server->RemoveDocument(2);
+            }
+            AssertSameAnswers(loaded, search_server, queries, hint + " after changes"s);
+        }
+    }
+    filesystem::remove(path);
+}
+
+void TestSnapshotRejectsDamagedFiles() {
+    mt19937 generator(3);
+    const vector<string> dictionary = MakeTestDictionary(40);
+    SearchServer search_server("w0"s);
+    search_server.SetIndexStorage(IndexStorage::COMPRESSED);
+    search_server.AddDocuments(MakeTestDocuments(generator, dictionary, 300));
+    const string path = TempSnapshotPath();
+    search_server.SaveIndex(path);
+    const string snapshot = ReadFile(path);
+    ASSERT(snapshot.size() > 64);
+
+    for (size_t size = 0; size < snapshot.size(); size += size < 64 ? 1 : 61) {
+        WriteFile(path, snapshot.substr(0, size));
+        ASSERT_THROWS(SearchServer::LoadIndex(path), runtime_error);
+    }
+    WriteFile(path, snapshot.substr(0, snapshot.size() - 1));
+    ASSERT_THROWS(SearchServer::LoadIndex(path), runtime_error);
+
+    string damaged = snapshot;
+    damaged[0] = 'X';
+    WriteFile(path, damaged);
+    ASSERT_THROWS(SearchServer::LoadIndex(path), runtime_error);
+    damaged = snapshot;
+    ++damaged[8];  // version
+    WriteFile(path, damaged);
+    ASSERT_THROWS(SearchServer::LoadIndex(path), runtime_error);
+
+    // Overwriting any word, section sizes included, must not make the loader
+    // read past the file. Some words are ratings, which load fine
+    for (size_t offset = 16; offset + 8 <= snapshot.size(); offset += 8) {
+        for (const uint64_t word : {~uint64_t{0}, ~uint64_t{3}, uint64_t{1} << 62}) {
+            damaged = snapshot;
+            memcpy(damaged.data() + offset, &word, sizeof(word));
+            WriteFile(path, damaged);
+            try {
+                SearchServer::LoadIndex(path);
+            } catch (const runtime_error&) {
+            }
+        }
+    }
+    filesystem::remove(path);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestSnapshotRoundTrip);
+    RUN_TEST(TestSnapshotRejectsDamagedFiles);
+    return 0;
+}
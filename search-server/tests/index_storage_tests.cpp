@@ -0,0 +1,159 @@
+// Compressed and plain posting lists must answer queries alike, whichever
+// way the index got its storage and whatever was removed from it.
+
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+// Quantized term frequencies may reorder documents whose relevances are close,
+// so results of different storages are compared by id
+vector<Document> SortById(vector<Document> documents) {
+    sort(documents.begin(), documents.end(), [](const Document& lhs, const Document& rhs) {
+        return lhs.id < rhs.id;
+    });
+    return documents;
+}
+
+// Relevance is shifted by up to 1e-5 of a block maximum times the inverse
+// document frequency, see IndexStorage::COMPRESSED
+const double QUANTIZATION_DEVIATION = 1e-4;
+
+// Removals in the middle of compressed lists leave packed blocks shorter than
+// BLOCK_SIZE, which switching back to plain lists must not assume
+void TestPlainAfterCompressedRemovals() {
+    SearchServer search_server(""s);
+    for (int id = 0; id < 1000; ++id) {
+        search_server.AddDocument(id, "common w"s + to_string(id % 3), DocumentStatus::ACTUAL, {id % 5});
+    }
+    search_server.SetIndexStorage(IndexStorage::COMPRESSED);
+    for (int id = 0; id < 300; id += 2) {
+        search_server.RemoveDocument(id);
+    }
+    search_server.SetQueryEvaluation(QueryEvaluation::WAND);
+    const auto compressed = search_server.FindTopDocuments("common w1"s, DocumentStatus::ACTUAL, 1000);
+    search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+    ASSERT_SAME_DOCUMENTS(compressed, search_server.FindTopDocuments("common w1"s, DocumentStatus::ACTUAL, 1000), DEVIATION);
+    ASSERT_EQUAL(compressed.size(), 850u);
+
+    search_server.SetIndexStorage(IndexStorage::PLAIN);
+    for (int id = 0; id < 1000; ++id) {
+        const auto [words, status] = search_server.MatchDocument("common"s, id < 300 && id % 2 == 0 ? 1 : id);
+        ASSERT_EQUAL(words.size(), 1u);
+    }
+    search_server.SetQueryEvaluation(QueryEvaluation::WAND);
+    ASSERT_SAME_DOCUMENTS(search_server.FindTopDocuments("common w1"s, DocumentStatus::ACTUAL, 1000), compressed, DEVIATION);
+    search_server.RemoveDocument(501);
+    ASSERT_EQUAL(search_server.FindTopDocuments("common w1"s, DocumentStatus::ACTUAL, 1000).size(), 849u);
+}
+
+// Purging tombstones and compacting rewrite compressed lists from their
+// unpacked form, including blocks already shortened by removals
+void TestCompressedPurgeAndCompaction() {
+    SearchServer compressed(""s);
+    SearchServer plain(""s);
+    compressed.SetIndexStorage(IndexStorage::COMPRESSED);
+    for (SearchServer* search_server : {&compressed, &plain}) {
+        for (int id = 0; id < 1000; ++id) {
+            // Term frequencies vary from block to block, so stale block maxima
+            // would show; common is left out of some documents to keep its weight
+            string text = "w"s + to_string(id % 3) + " x"s + to_string(id % 7);
+            for (int i = 0; id % 5 != 0 && i <= id / 90 % 11; ++i) {
+                text += " common"s;
+            }
+            search_server->AddDocument(id, text, DocumentStatus::ACTUAL, {id % 5});
+        }
+        for (int id = 0; id < 400; id += 3) {
+            search_server->RemoveDocument(id);
+        }
+        search_server->SetDeletionMode(DeletionMode::TOMBSTONE);
+        for (int id = 400; id < 700; id += 2) {
+            search_server->RemoveDocument(id);
+        }
+    }
+    for (const bool is_compacted : {false, true}) {
+        if (is_compacted) {
+            compressed.CompactIndex();
+            plain.CompactIndex();
+        }
+        for (const QueryEvaluation evaluation : {QueryEvaluation::EXHAUSTIVE, QueryEvaluation::WAND}) {
+            compressed.SetQueryEvaluation(evaluation);
+            for (const string& query : {"common"s, "w1 x3"s, "w2 -x4"s, "x6 common"s}) {
+                ASSERT_SAME_DOCUMENTS_HINT(SortById(compressed.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000)),
+                                           SortById(plain.FindTopDocuments(query, DocumentStatus::ACTUAL, 1000)),
+                                           QUANTIZATION_DEVIATION, query);
+            }
+        }
+    }
+    compressed.SetIndexStorage(IndexStorage::PLAIN);
+    ASSERT_SAME_DOCUMENTS(SortById(compressed.FindTopDocuments("w0 x0"s, DocumentStatus::ACTUAL, 1000)),
+                          SortById(plain.FindTopDocuments("w0 x0"s, DocumentStatus::ACTUAL, 1000)), QUANTIZATION_DEVIATION);
+}
+
+void AssertSameResults(const SearchServer& search_server, const SearchServer& reference, const vector<string>& queries,
+                       const string& hint) {
+    for (const string& query : queries) {
+        ASSERT_SAME_DOCUMENTS_HINT(SortById(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, 10000)),
+                                   SortById(reference.FindTopDocuments(query, DocumentStatus::ACTUAL, 10000)),
+                                   QUANTIZATION_DEVIATION, hint + ", query "s + query);
+    }
+    for (const int document_id : reference) {
+        const auto [words, status] = search_server.MatchDocument(queries[document_id % queries.size()], document_id);
+        const auto [reference_words, reference_status] = reference.MatchDocument(queries[document_id % queries.size()], document_id);
+        ASSERT_HINT(words == reference_words && status == reference_status, hint + ", document "s + to_string(document_id));
+    }
+}
+
+// Lists from a few postings to many full blocks, with a full or partial
+// last block, compressed while built, after it, and back to plain
+void TestCompressedMatchesPlain() {
+    mt19937 generator(7);
+    const vector<string> dictionary = MakeTestDictionary(40);
+    vector<string> queries;
+    for (int i = 0; i < 20; ++i) {
+        queries.push_back(MakeTestText(generator, dictionary, 4, 0.2));
+    }
+    for (const int document_count : {60, 128, 129, 256, 300, 1500}) {
+        const vector<NewDocument> documents = MakeTestDocuments(generator, dictionary, document_count);
+        SearchServer plain("w39"s);
+        SearchServer compressed_before("w39"s);
+        SearchServer compressed_after("w39"s);
+        compressed_before.SetIndexStorage(IndexStorage::COMPRESSED);
+        for (SearchServer* search_server : {&plain, &compressed_before, &compressed_after}) {
+            search_server->AddDocuments(documents);
+        }
+        compressed_after.SetIndexStorage(IndexStorage::COMPRESSED);
+        const string hint = to_string(document_count) + " documents"s;
+        AssertSameResults(compressed_before, plain, queries, hint);
+        AssertSameResults(compressed_after, plain, queries, hint);
+
+        // Removals from the middle of lists, then appends behind them
+        for (SearchServer* search_server : {&plain, &compressed_before, &compressed_after}) {
+            for (int id = 0; id < document_count; id += 1 + id % 4) {
+                search_server->RemoveDocument(id);
+            }
+            search_server->AddDocument(document_count, "w0 w1 w2"s, DocumentStatus::ACTUAL, {1});
+        }
+        AssertSameResults(compressed_before, plain, queries, hint + " after removals"s);
+        AssertSameResults(compressed_after, plain, queries, hint + " after removals"s);
+        compressed_before.SetIndexStorage(IndexStorage::PLAIN);
+        AssertSameResults(compressed_before, plain, queries, hint + " back to plain"s);
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestPlainAfterCompressedRemovals);
+    RUN_TEST(TestCompressedPurgeAndCompaction);
+    RUN_TEST(TestCompressedMatchesPlain);
+    return 0;
+}
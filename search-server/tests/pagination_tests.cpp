@@ -0,0 +1,138 @@
+// Pages of results, by offset or by cursor, must concatenate to the full
+// ranking, ties across page boundaries included.
+
+#include "../paginator.h"
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const size_t ALL_DOCUMENTS = 100000;
+
+vector<int> GetIds(const vector<Document>& documents) {
+    vector<int> ids;
+    for (const Document& document : documents) {
+        ids.push_back(document.id);
+    }
+    return ids;
+}
+
+// Many documents share texts and ratings, so whole runs of them tie
+SearchServer MakeServerWithTies(mt19937& generator, IndexStorage storage, QueryEvaluation evaluation) {
+    const vector<string> dictionary = MakeTestDictionary(8);
+    SearchServer search_server("w7"s);
+    search_server.SetIndexStorage(storage);
+    search_server.SetQueryEvaluation(evaluation);
+    const vector<string> texts = {MakeTestText(generator, dictionary, 3), MakeTestText(generator, dictionary, 5),
+                                  MakeTestText(generator, dictionary, 4)};
+    vector<NewDocument> documents = MakeTestDocuments(generator, dictionary, 500);
+    for (NewDocument& document : documents) {
+        if (document.id % 3 != 0) {
+            document.text = texts[document.id % texts.size()];
+            document.ratings = {document.id % 2};
+        }
+    }
+    search_server.AddDocuments(documents);
+    return search_server;
+}
+
+void TestPagesConcatenateToFullRanking() {
+    mt19937 generator(17);
+    const vector<string> queries = {"w1"s, "w0 w2"s, "w1 w3 -w5"s, "w4 w6 w2 w1"s};
+    for (const IndexStorage storage : {IndexStorage::PLAIN, IndexStorage::COMPRESSED}) {
+        for (const QueryEvaluation evaluation : {QueryEvaluation::EXHAUSTIVE, QueryEvaluation::WAND}) {
+            const SearchServer search_server = MakeServerWithTies(generator, storage, evaluation);
+            for (const string& query : queries) {
+                const vector<Document> full = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, ALL_DOCUMENTS);
+                ASSERT_HINT(adjacent_find(full.begin(), full.end(), [](const Document& lhs, const Document& rhs) {
+                                return lhs.relevance == rhs.relevance && lhs.rating == rhs.rating;
+                            }) != full.end(),
+                            query);
+                for (const size_t page_size : {1u, 2u, 7u, 50u}) {
+                    const string hint = query + ", page size "s + to_string(page_size);
+                    vector<Document> by_offset;
+                    for (size_t offset = 0; offset < full.size() + page_size; offset += page_size) {
+                        const auto page = search_server.FindTopDocumentsPage(query, DocumentStatus::ACTUAL, offset, page_size);
+                        by_offset.insert(by_offset.end(), page.begin(), page.end());
+                    }
+                    ASSERT_SAME_DOCUMENTS_HINT(by_offset, full, 0.0, hint);
+
+                    // Cursors also pass through their text form, as with a client
+                    vector<Document> by_cursor;
+                    const auto fetch = [&](const SearchCursor& after, size_t limit) {
+                        return search_server.FindTopDocumentsAfter(query, DocumentStatus::ACTUAL,
+                                                                   SearchCursor::FromString(after.ToString()), limit);
+                    };
+                    for (const vector<Document>& page : PaginateLazily(fetch, page_size)) {
+                        ASSERT_HINT(page.size() <= page_size, hint);
+                        by_cursor.insert(by_cursor.end(), page.begin(), page.end());
+                    }
+                    ASSERT_SAME_DOCUMENTS_HINT(by_cursor, full, 0.0, hint);
+                }
+            }
+        }
+    }
+}
+
+// Removals change inverse document frequencies and so every relevance, but
+// not the order of the documents of a one-word query
+void TestPagesAcrossRemovals() {
+    mt19937 generator(23);
+    for (const DeletionMode deletion_mode : {DeletionMode::IMMEDIATE, DeletionMode::TOMBSTONE}) {
+        for (const QueryEvaluation evaluation : {QueryEvaluation::EXHAUSTIVE, QueryEvaluation::WAND}) {
+            SearchServer search_server = MakeServerWithTies(generator, IndexStorage::PLAIN, evaluation);
+            search_server.SetDeletionMode(deletion_mode);
+            set<int> removed;
+            for (const string& query : {"w1"s, "w2 w4 -w3"s}) {
+                const vector<int> full = GetIds(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, ALL_DOCUMENTS));
+                ASSERT(full.size() > 60);
+                vector<int> shown;
+                vector<Document> page = search_server.FindTopDocumentsAfter(query, DocumentStatus::ACTUAL, SearchCursor::First(), 10);
+                while (!page.empty()) {
+                    for (const Document& document : page) {
+                        ASSERT_HINT(removed.count(document.id) == 0, query + ", id "s + to_string(document.id));
+                        shown.push_back(document.id);
+                    }
+                    // One document already shown, one still to come and one
+                    // the query does not match, never the cursor's
+                    const size_t next = shown.size() + 3;
+                    for (const int id : {shown.front(), next < full.size() ? full[next] : -1, 499 - static_cast<int>(shown.size())}) {
+                        if (id >= 0 && id != shown.back() && removed.count(id) == 0) {
+                            search_server.RemoveDocument(id);
+                            removed.insert(id);
+                        }
+                    }
+                    page = search_server.FindTopDocumentsAfter(query, DocumentStatus::ACTUAL, SearchCursor::After(page.back()), 10);
+                }
+                if (query.find(' ') != string::npos) {
+                    continue;
+                }
+                vector<int> expected;
+                for (const int id : full) {
+                    if (find(shown.begin(), shown.end(), id) != shown.end() || removed.count(id) == 0) {
+                        expected.push_back(id);
+                    }
+                }
+                ASSERT_EQUAL_HINT(shown.size(), expected.size(), query);
+                ASSERT_HINT(shown == expected, query);
+            }
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestPagesConcatenateToFullRanking);
+    RUN_TEST(TestPagesAcrossRemovals);
+    return 0;
+}
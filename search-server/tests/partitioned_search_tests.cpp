@@ -0,0 +1,147 @@
+// Servers that split the index, by document id or into segments, must answer
+// like a single SearchServer holding every document.
+
+#include "../search_server.h"
+#include "../segmented_search_server.h"
+#include "../sharded_search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const string STOP_WORDS = "w0 w4"s;
+
+template <typename Server>
+void AssertSameAnswers(const Server& server, const SearchServer& reference, const vector<string>& queries,
+                       const string& hint) {
+    const auto is_odd = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 != 0;
+    };
+    ASSERT_EQUAL_HINT(server.GetDocumentCount(), reference.GetDocumentCount(), hint);
+    for (const string& query : queries) {
+        const string query_hint = hint + ", query "s + query;
+        for (const size_t max_count : {5u, 10000u}) {
+            ASSERT_SAME_DOCUMENTS_HINT(server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_count),
+                                       reference.FindTopDocuments(query, DocumentStatus::ACTUAL, max_count), 0.0, query_hint);
+            ASSERT_SAME_DOCUMENTS_HINT(server.FindTopDocuments(query, is_odd, max_count),
+                                       reference.FindTopDocuments(query, is_odd, max_count), 0.0, query_hint);
+        }
+        for (const int id : reference) {
+            const auto [words, status] = server.MatchDocument(query, id);
+            const auto [reference_words, reference_status] = reference.MatchDocument(query, id);
+            ASSERT_HINT(words == reference_words, query_hint + ", id "s + to_string(id));
+            ASSERT_HINT(status == reference_status, query_hint + ", id "s + to_string(id));
+        }
+    }
+}
+
+vector<string> MakeQueries(mt19937& generator, const vector<string>& dictionary) {
+    vector<string> queries;
+    for (int i = 0; i < 25; ++i) {
+        queries.push_back(MakeTestText(generator, dictionary, 1 + i % 5, 0.15));
+    }
+    return queries;
+}
+
+// Adds, removes and adds documents again, comparing answers after each step.
+// Returns the single server holding the same documents
+template <typename Server>
+SearchServer CheckAgainstSingleServer(Server& server, mt19937& generator, const vector<string>& dictionary,
+                                      const vector<string>& queries, const string& hint) {
+    SearchServer reference(STOP_WORDS);
+    const auto add_documents = [&](int first_id) {
+        for (const NewDocument& document : MakeTestDocuments(generator, dictionary, 400, first_id)) {
+            server.AddDocument(document.id, document.text, document.status, document.ratings);
+            reference.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+    };
+    add_documents(0);
+    AssertSameAnswers(server, reference, queries, hint);
+    for (int id = 0; id < 400; id += 7) {
+        server.RemoveDocument(id);
+        reference.RemoveDocument(id);
+    }
+    AssertSameAnswers(server, reference, queries, hint + " after removals"s);
+    add_documents(400);
+    AssertSameAnswers(server, reference, queries, hint + " after more additions"s);
+    return reference;
+}
+
+void TestShardedMatchesSingleServer() {
+    mt19937 generator(5);
+    const vector<string> dictionary = MakeTestDictionary(50);
+    const vector<string> queries = MakeQueries(generator, dictionary);
+    for (const size_t shard_count : {1u, 3u, 8u}) {
+        for (const QueryEvaluation evaluation : {QueryEvaluation::EXHAUSTIVE, QueryEvaluation::WAND}) {
+            ShardedSearchServer server(STOP_WORDS, shard_count);
+            server.SetQueryEvaluation(evaluation);
+            CheckAgainstSingleServer(server, generator, dictionary, queries,
+                                     to_string(shard_count) + " shards"s
+                                         + (evaluation == QueryEvaluation::WAND ? ", WAND"s : ""s));
+        }
+    }
+}
+
+void TestSegmentedMatchesSingleServer() {
+    mt19937 generator(9);
+    const vector<string> dictionary = MakeTestDictionary(50);
+    const vector<string> queries = MakeQueries(generator, dictionary);
+    for (const bool merge_in_background : {false, true}) {
+        SegmentOptions options;
+        options.max_buffer_documents = 60;
+        options.max_segment_count = 3;
+        options.merge_factor = 2;
+        // Compressed segments agree only to within the quantization error
+        options.segment_storage = IndexStorage::PLAIN;
+        options.merge_in_background = merge_in_background;
+        SegmentedSearchServer server(STOP_WORDS, options);
+        const string hint = merge_in_background ? "background merges"s : "foreground merges"s;
+        const SearchServer reference = CheckAgainstSingleServer(server, generator, dictionary, queries, hint);
+        server.MergeAllSegments();
+        ASSERT_EQUAL(server.GetSegmentCount(), 1u);
+        AssertSameAnswers(server, reference, queries, hint + " after merging all segments"s);
+    }
+
+    // Documents that never leave the write buffer
+    SegmentOptions options;
+    options.max_buffer_documents = 100000;
+    SegmentedSearchServer server(STOP_WORDS, options);
+    CheckAgainstSingleServer(server, generator, dictionary, queries, "write buffer only"s);
+    ASSERT_EQUAL(server.GetSegmentCount(), 0u);
+}
+
+// Merges free the segments a document was matched in
+void TestSegmentedMatchedWordsOutliveMerges() {
+    SegmentOptions options;
+    options.max_buffer_documents = 4;
+    options.max_segment_count = 2;
+    options.merge_factor = 2;
+    options.merge_in_background = false;
+    SegmentedSearchServer server("and"s, options);
+    server.AddDocument(1, "white cat and fancy collar"s, DocumentStatus::ACTUAL, {8, -3});
+    server.Flush();
+    const auto [words, status] = server.MatchDocument("fancy cat dog"s, 1);
+
+    for (int id = 2; id < 40; ++id) {
+        server.AddDocument(id, "groomed dog number "s + to_string(id), DocumentStatus::ACTUAL, {1});
+    }
+    server.MergeAllSegments();
+    ASSERT_EQUAL(server.GetSegmentCount(), 1u);
+    ASSERT((vector<string>(words.begin(), words.end()) == vector<string>{"cat"s, "fancy"s}));
+    ASSERT(status == DocumentStatus::ACTUAL);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestShardedMatchesSingleServer);
+    RUN_TEST(TestSegmentedMatchesSingleServer);
+    RUN_TEST(TestSegmentedMatchedWordsOutliveMerges);
+    return 0;
+}
@@ -0,0 +1,87 @@
+// WAND must return the same top documents as exhaustive evaluation: its
+// threshold prunes only documents ranked below every kept one.
+
+#include "../search_server.h"
+#include "test_corpus.h"
+#include "test_framework.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+void AssertWandMatchesExhaustive(SearchServer& search_server, const vector<string>& queries, const string& hint) {
+    const auto is_even = [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    };
+    for (const string& query : queries) {
+        for (const size_t max_count : {1u, 5u, 20u, 10000u}) {
+            search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+            const auto exhaustive = search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_count);
+            const auto exhaustive_even = search_server.FindTopDocuments(query, is_even, max_count);
+            const auto exhaustive_page = search_server.FindTopDocumentsPage(query, 3, max_count);
+            search_server.SetQueryEvaluation(QueryEvaluation::WAND);
+            const string query_hint = hint + ", query "s + query + ", max_count "s + to_string(max_count);
+            // Both sum the words of a document in the same order, so relevances are equal
+            ASSERT_SAME_DOCUMENTS_HINT(search_server.FindTopDocuments(query, DocumentStatus::ACTUAL, max_count), exhaustive,
+                                       0.0, query_hint);
+            ASSERT_SAME_DOCUMENTS_HINT(search_server.FindTopDocuments(query, is_even, max_count), exhaustive_even, 0.0,
+                                       query_hint);
+            ASSERT_SAME_DOCUMENTS_HINT(search_server.FindTopDocumentsPage(query, 3, max_count), exhaustive_page, 0.0,
+                                       query_hint);
+        }
+    }
+}
+
+void TestWandMatchesExhaustive() {
+    mt19937 generator(11);
+    // A short dictionary makes many documents tie on relevance
+    const vector<string> dictionary = MakeTestDictionary(30);
+    vector<string> queries;
+    for (int i = 0; i < 40; ++i) {
+        queries.push_back(MakeTestText(generator, dictionary, 1 + i % 6, 0.15));
+    }
+    for (const IndexStorage storage : {IndexStorage::PLAIN, IndexStorage::COMPRESSED}) {
+        for (const int document_count : {50, 700, 3000}) {
+            // Stop words are among the most frequent words of the corpus
+            SearchServer search_server("w0 w3"s);
+            search_server.SetIndexStorage(storage);
+            search_server.AddDocuments(MakeTestDocuments(generator, dictionary, document_count));
+            const string hint = (storage == IndexStorage::PLAIN ? "plain, "s : "compressed, "s) + to_string(document_count)
+                                + " documents"s;
+            AssertWandMatchesExhaustive(search_server, queries, hint);
+            for (int id = 0; id < document_count; id += 3) {
+                search_server.RemoveDocument(id);
+            }
+            AssertWandMatchesExhaustive(search_server, queries, hint + " after removals"s);
+        }
+    }
+}
+
+// Every document has the same relevance, so only ratings and ids order them
+void TestWandWithTies() {
+    SearchServer search_server(""s);
+    for (int id = 0; id < 1000; ++id) {
+        search_server.AddDocument(id, "cat dog"s, DocumentStatus::ACTUAL, {id % 7});
+    }
+    search_server.AddDocument(1000, "bird"s, DocumentStatus::ACTUAL, {0});
+    for (const size_t max_count : {1u, 7u, 300u}) {
+        search_server.SetQueryEvaluation(QueryEvaluation::EXHAUSTIVE);
+        const auto exhaustive = search_server.FindTopDocuments("cat dog -bird"s, DocumentStatus::ACTUAL, max_count);
+        search_server.SetQueryEvaluation(QueryEvaluation::WAND);
+        ASSERT_SAME_DOCUMENTS(search_server.FindTopDocuments("cat dog -bird"s, DocumentStatus::ACTUAL, max_count), exhaustive, 0.0);
+        ASSERT_EQUAL(exhaustive.size(), max_count);
+        ASSERT_EQUAL(exhaustive[0].rating, 6);
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestWandMatchesExhaustive);
+    RUN_TEST(TestWandWithTies);
+    return 0;
+}
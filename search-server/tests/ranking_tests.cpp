@@ -0,0 +1,72 @@
+// Boundary cases of the ranking order, see HasHigherRank.
+
+#include "../search_server.h"
+#include "../top_documents.h"
+#include "test_framework.h"
+
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+vector<Document> Rank(const vector<Document>& documents) {
+    TopDocuments top_documents(documents.size());
+    for (const Document& document : documents) {
+        top_documents.Push(document);
+    }
+    return top_documents.ExtractSorted();
+}
+
+void TestCloseRelevancesInOneBucketRankByRating() {
+    const Document lower(1, 0.5000002, 9);
+    const Document higher(2, 0.5000008, 1);
+    ASSERT(HasHigherRank(lower, higher));
+    ASSERT(!HasHigherRank(higher, lower));
+    ASSERT_SAME_DOCUMENTS(Rank({higher, lower}), (vector<Document>{lower, higher}), 0.0);
+}
+
+// Less than DEVIATION apart, but on either side of a multiple of it
+void TestCloseRelevancesAcrossBucketsRankByRelevance() {
+    const Document lower(1, 0.4999996, 9);
+    const Document higher(2, 0.5000003, 1);
+    ASSERT(higher.relevance - lower.relevance < DEVIATION);
+    ASSERT(HasHigherRank(higher, lower));
+    ASSERT(!HasHigherRank(lower, higher));
+    ASSERT_SAME_DOCUMENTS(Rank({lower, higher}), (vector<Document>{higher, lower}), 0.0);
+}
+
+void TestEqualRelevanceAndRatingRankById() {
+    const Document first(3, 0.25, 4);
+    const Document second(7, 0.25, 4);
+    ASSERT(HasHigherRank(first, second));
+    ASSERT(!HasHigherRank(second, first));
+    ASSERT(!HasHigherRank(first, first));
+}
+
+// Each neighbour is less than DEVIATION from the next, which pairwise
+// comparison within DEVIATION could not order consistently
+void TestChainOfCloseRelevancesIsOrdered() {
+    vector<Document> documents;
+    for (int id = 0; id < 12; ++id) {
+        documents.push_back({id, 0.7 + id * 0.6 * DEVIATION, (id * 5) % 7});
+    }
+    const vector<Document> ranked = Rank(documents);
+    for (size_t i = 0; i + 1 < ranked.size(); ++i) {
+        ASSERT_HINT(HasHigherRank(ranked[i], ranked[i + 1]), "position "s + to_string(i));
+        for (size_t j = i + 1; j < ranked.size(); ++j) {
+            ASSERT_HINT(!HasHigherRank(ranked[j], ranked[i]), "positions "s + to_string(i) + ", "s + to_string(j));
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestCloseRelevancesInOneBucketRankByRating);
+    RUN_TEST(TestCloseRelevancesAcrossBucketsRankByRelevance);
+    RUN_TEST(TestEqualRelevanceAndRatingRankById);
+    RUN_TEST(TestChainOfCloseRelevancesIsOrdered);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Behavior of the baseline SearchServer API that every storage and
+// evaluation mode builds on.
+
+#include "../paginator.h"
+#include "../search_server.h"
+#include "test_framework.h"
+
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+SearchServer MakePetServer() {
+    SearchServer search_server("and with"s);
+    search_server.AddDocument(1, "funny pet and nasty rat"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "funny pet with curly hair"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    search_server.AddDocument(3, "big cat nasty hair"s, DocumentStatus::BANNED, {1, 2, 8});
+    search_server.AddDocument(4, "big dog cat Vladislav"s, DocumentStatus::IRRELEVANT, {1, 3, 2});
+    search_server.AddDocument(5, "big dog hamster Borya"s, DocumentStatus::ACTUAL, {1, 1, 1});
+    return search_server;
+}
+
+void TestStopWordsAreExcluded() {
+    SearchServer search_server("in the"s);
+    search_server.AddDocument(42, "cat in the city"s, DocumentStatus::ACTUAL, {1, 2, 3});
+    ASSERT(search_server.FindTopDocuments("in"s).empty());
+    ASSERT_EQUAL(search_server.FindTopDocuments("cat"s).size(), 1u);
+}
+
+void TestMinusWordsExcludeDocuments() {
+    const SearchServer search_server = MakePetServer();
+    const auto documents = search_server.FindTopDocuments("funny pet -rat"s);
+    ASSERT_EQUAL(documents.size(), 1u);
+    ASSERT_EQUAL(documents[0].id, 2);
+}
+
+void TestMatchDocument() {
+    const SearchServer search_server = MakePetServer();
+    const auto [words, status] = search_server.MatchDocument("nasty funny cat"s, 1);
+    ASSERT_EQUAL(words.size(), 2u);
+    ASSERT_EQUAL(words[0], "funny"s);
+    ASSERT_EQUAL(words[1], "nasty"s);
+    ASSERT(status == DocumentStatus::ACTUAL);
+    ASSERT(get<0>(search_server.MatchDocument("funny -rat"s, 1)).empty());
+    ASSERT_EQUAL(get<0>(search_server.MatchDocument(execution::par, "nasty funny cat"s, 1)).size(), 2u);
+}
+
+void TestRelevanceAndRating() {
+    const SearchServer search_server = MakePetServer();
+    const auto documents = search_server.FindTopDocuments("funny nasty rat"s);
+    ASSERT_EQUAL(documents.size(), 2u);
+    ASSERT_EQUAL(documents[0].id, 1);
+    ASSERT_EQUAL(documents[0].rating, 5);
+    // Three of the four words left once "and" is dropped; funny and nasty are in two documents each
+    const double expected = 0.25 * log(5.0 / 2) + 0.25 * log(5.0 / 2) + 0.25 * log(5.0 / 1);
+    ASSERT(abs(documents[0].relevance - expected) < DEVIATION);
+    ASSERT(documents[0].relevance > documents[1].relevance);
+}
+
+void TestStatusAndPredicate() {
+    const SearchServer search_server = MakePetServer();
+    ASSERT_EQUAL(search_server.FindTopDocuments("big"s).size(), 1u);
+    ASSERT_EQUAL(search_server.FindTopDocuments("big"s, DocumentStatus::BANNED).size(), 1u);
+    const auto even = search_server.FindTopDocuments("big"s, [](int document_id, DocumentStatus, int) {
+        return document_id % 2 == 0;
+    });
+    ASSERT_EQUAL(even.size(), 1u);
+    ASSERT_EQUAL(even[0].id, 4);
+}
+
+void TestRemoveDocument() {
+    SearchServer search_server = MakePetServer();
+    search_server.RemoveDocument(1);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 4);
+    ASSERT(search_server.FindTopDocuments("rat"s).empty());
+    search_server.RemoveDocument(execution::par, 2);
+    ASSERT(search_server.FindTopDocuments("funny"s).empty());
+    ASSERT_THROWS(search_server.RemoveDocument(1), out_of_range);
+}
+
+void TestInvalidInput() {
+    SearchServer search_server = MakePetServer();
+    ASSERT_THROWS(search_server.AddDocument(1, "again"s, DocumentStatus::ACTUAL, {1}), invalid_argument);
+    ASSERT_THROWS(search_server.AddDocument(-1, "negative"s, DocumentStatus::ACTUAL, {1}), invalid_argument);
+    ASSERT_THROWS(search_server.AddDocument(6, "bad\x12word"s, DocumentStatus::ACTUAL, {1}), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("--cat"s), invalid_argument);
+    ASSERT_THROWS(search_server.FindTopDocuments("cat -"s), invalid_argument);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 5);
+}
+
+void TestPaginate() {
+    const vector<int> values = {1, 2, 3, 4, 5};
+    const auto pages = Paginate(values, 2);
+    ASSERT_EQUAL(pages.size(), 3u);
+    ASSERT_EQUAL(pages.begin()->size(), 2u);
+    ASSERT_EQUAL((pages.begin() + 2)->size(), 1u);
+}
+
+}  // namespace
+
+int main() {
+    RUN_TEST(TestStopWordsAreExcluded);
+    RUN_TEST(TestMinusWordsExcludeDocuments);
+    RUN_TEST(TestMatchDocument);
+    RUN_TEST(TestRelevanceAndRating);
+    RUN_TEST(TestStatusAndPredicate);
+    RUN_TEST(TestRemoveDocument);
+    RUN_TEST(TestInvalidInput);
+    RUN_TEST(TestPaginate);
+    return 0;
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "../document.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+// Small random corpora for tests that compare two ways of answering the same
+// queries. Words come from a short dictionary, so documents share words and
+// relevances often tie
+
+inline std::vector<std::string> MakeTestDictionary(int word_count) {
+    std::vector<std::string> words;
+    for (int i = 0; i < word_count; ++i) {
+        words.push_back("w" + std::to_string(i));
+    }
+    return words;
+}
+
+// Lower word indexes are more frequent, so some words occur in most documents
+inline std::string MakeTestText(std::mt19937& generator, const std::vector<std::string>& dictionary, int word_count,
+                                double minus_prob = 0.0) {
+    std::string text;
+    for (int i = 0; i < word_count; ++i) {
+        if (i > 0) {
+            text.push_back(' ');
+        }
+        if (std::uniform_real_distribution<>(0, 1)(generator) < minus_prob) {
+            text.push_back('-');
+        }
+        const int max_index = std::uniform_int_distribution<int>(0, static_cast<int>(dictionary.size()) - 1)(generator);
+        text += dictionary[std::uniform_int_distribution<int>(0, max_index)(generator)];
+    }
+    return text;
+}
+
+inline std::vector<NewDocument> MakeTestDocuments(std::mt19937& generator, const std::vector<std::string>& dictionary,
+                                                  int document_count, int first_id = 0) {
+    std::vector<NewDocument> documents;
+    for (int i = 0; i < document_count; ++i) {
+        const int rating = std::uniform_int_distribution<int>(-3, 3)(generator);
+        const auto status = static_cast<DocumentStatus>(std::uniform_int_distribution<int>(0, 3)(generator) / 3);
+        documents.push_back({first_id + i, MakeTestText(generator, dictionary, std::uniform_int_distribution<int>(1, 12)(generator)),
+                             status, {rating, rating}});
+    }
+    return documents;
+}
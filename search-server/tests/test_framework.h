@@ -0,0 +1,94 @@
+#pragma once
+#include "../document.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Assertions of the test executables in tests/. A failed check prints where
+// it failed and aborts, so ctest reports the executable as failed.
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std::string& u_str, const std::string& file,
+                     const std::string& func, unsigned line, const std::string& hint) {
+    if (t != u) {
+        std::cerr << file << "(" << line << "): " << func << ": ASSERT_EQUAL(" << t_str << ", " << u_str << ") failed: "
+                  << t << " != " << u << ".";
+        if (!hint.empty()) {
+            std::cerr << " Hint: " << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, std::string())
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+inline void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func,
+                       unsigned line, const std::string& hint) {
+    if (!value) {
+        std::cerr << file << "(" << line << "): " << func << ": ASSERT(" << expr_str << ") failed.";
+        if (!hint.empty()) {
+            std::cerr << " Hint: " << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, std::string())
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+#define ASSERT_THROWS(expr, exception_type)                                                              \
+    do {                                                                                                 \
+        bool is_thrown = false;                                                                          \
+        try {                                                                                            \
+            expr;                                                                                        \
+        } catch (const exception_type&) {                                                                \
+            is_thrown = true;                                                                            \
+        }                                                                                                \
+        AssertImpl(is_thrown, #expr " throws " #exception_type, __FILE__, __FUNCTION__, __LINE__, std::string()); \
+    } while (false)
+
+// Documents are equal if their ids and ratings are and their relevances are
+// within max_deviation
+inline void AssertSameDocumentsImpl(const std::vector<Document>& lhs, const std::vector<Document>& rhs,
+                                    double max_deviation, const std::string& file, const std::string& func,
+                                    unsigned line, const std::string& hint) {
+    bool is_same = lhs.size() == rhs.size();
+    for (size_t i = 0; is_same && i < lhs.size(); ++i) {
+        is_same = lhs[i].id == rhs[i].id && lhs[i].rating == rhs[i].rating
+                  && std::abs(lhs[i].relevance - rhs[i].relevance) <= max_deviation;
+    }
+    if (!is_same) {
+        std::cerr << file << "(" << line << "): " << func << ": documents differ.";
+        if (!hint.empty()) {
+            std::cerr << " Hint: " << hint;
+        }
+        std::cerr << std::endl;
+        for (const auto* documents : {&lhs, &rhs}) {
+            std::cerr << "  " << documents->size() << " documents:";
+            for (const Document& document : *documents) {
+                std::cerr << ' ' << document;
+            }
+            std::cerr << std::endl;
+        }
+        std::abort();
+    }
+}
+
+#define ASSERT_SAME_DOCUMENTS(lhs, rhs, max_deviation) \
+    AssertSameDocumentsImpl((lhs), (rhs), (max_deviation), __FILE__, __FUNCTION__, __LINE__, std::string())
+#define ASSERT_SAME_DOCUMENTS_HINT(lhs, rhs, max_deviation, hint) \
+    AssertSameDocumentsImpl((lhs), (rhs), (max_deviation), __FILE__, __FUNCTION__, __LINE__, (hint))
+
+template <typename Func>
+void RunTestImpl(Func func, const std::string& func_name) {
+    func();
+    std::cerr << func_name << " OK" << std::endl;
+}
+
+#define RUN_TEST(func) RunTestImpl((func), #func)
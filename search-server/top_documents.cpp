@@ -0,0 +1,68 @@
+#include "top_documents.h"
+#include "search_server.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+bool HasHigherRank(const Document& lhs, const Document& rhs) {
+    // Relevance is compared by DEVIATION-wide buckets rather than within a
+    // DEVIATION of each other, which would not be transitive
+    const double lhs_bucket = floor(lhs.relevance / DEVIATION);
+    const double rhs_bucket = floor(rhs.relevance / DEVIATION);
+    if (lhs_bucket != rhs_bucket) {
+        return lhs_bucket > rhs_bucket;
+    }
+    if (lhs.rating != rhs.rating) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.id < rhs.id;
+}
+
+TopDocuments::TopDocuments(size_t max_count)
+    : max_count_(max_count) {
+    // Deep pages keep many documents, but a query may match fewer
+    heap_.reserve(min<size_t>(max_count_, 1024));
+}
+
+TopDocuments::TopDocuments(size_t max_count, const Document& after)
+    : TopDocuments(max_count) {
+    after_ = after;
+}
+
+void TopDocuments::Push(const Document& document) {
+    if (after_ && !HasHigherRank(*after_, document)) {
+        return;
+    }
+    if (heap_.size() < max_count_) {
+        heap_.push_back(document);
+        push_heap(heap_.begin(), heap_.end(), HasHigherRank);
+    } else if (max_count_ > 0 && HasHigherRank(document, heap_.front())) {
+        pop_heap(heap_.begin(), heap_.end(), HasHigherRank);
+        heap_.back() = document;
+        push_heap(heap_.begin(), heap_.end(), HasHigherRank);
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments& other) {
+    for (const Document& document : other.heap_) {
+        Push(document);
+    }
+}
+
+size_t TopDocuments::GetMaxCount() const {
+    return max_count_;
+}
+
+bool TopDocuments::IsFull() const {
+    return max_count_ > 0 && heap_.size() >= max_count_;
+}
+
+const Document& TopDocuments::GetLowest() const {
+    return heap_.front();
+}
+
+vector<Document> TopDocuments::ExtractSorted() {
+    sort_heap(heap_.begin(), heap_.end(), HasHigherRank);
+    return move(heap_);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "document.h"
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+// Ranking order of search results: by relevance rounded down to a multiple of
+// DEVIATION, then by rating, then by id. A strict weak ordering, so a page
+// following a document ranked by it neither skips nor repeats documents.
+// Relevances less than DEVIATION apart used to count as equal; now two of them
+// on either side of a multiple of DEVIATION rank by relevance, not by rating.
+// The old rule was not transitive, so sorting could order such documents
+// either way
+bool HasHigherRank(const Document& lhs, const Document& rhs);
+
+// Keeps the max_count highest-ranked documents pushed so far in a bounded heap,
+// so selecting the top of n documents costs O(n log max_count) instead of a full sort
+class TopDocuments {
+public:
+    explicit TopDocuments(size_t max_count);
+    // Keeps only documents ranked below after, for the page that follows it
+    TopDocuments(size_t max_count, const Document& after);
+
+    void Push(const Document& document);
+    void Merge(const TopDocuments& other);
+    size_t GetMaxCount() const;
+    // Never true for max_count 0, so a full top always has a lowest document
+    bool IsFull() const;
+    // The lowest-ranked document kept so far; the heap must not be empty
+    const Document& GetLowest() const;
+    // Returns the kept documents in ranking order and leaves the heap empty
+    std::vector<Document> ExtractSorted();
+
+private:
+    size_t max_count_;
+    std::optional<Document> after_;
+    // Max-heap by HasHigherRank: the lowest-ranked document is on top
+    std::vector<Document> heap_;
+};